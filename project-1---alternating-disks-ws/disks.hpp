@@ -12,10 +12,18 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cctype>
 #include <cstddef>
-#include <sstream>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <random>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
 // TODO
@@ -24,27 +32,726 @@
 
 enum disk_color { DISK_DARK, DISK_LIGHT};
 
+// Rows of disks are stored one bit per disk, packed into 64-bit words. Disk i
+// lives in bit (i % 64) of word (i / 64); the bit is set for a light disk and
+// clear for a dark disk. Bits past the end of the row are always clear.
+//
+// The functions below run whole sorting passes directly on the words, so one
+// word operation handles 64 adjacent disks at a time. Each one returns the
+// number of swaps the equivalent element-by-element pass would have
+// performed. There are two implementations of every pass, selected by a
+// disk_backend: portable scalar code, and AVX2 code that handles four words
+// (256 disks) per instruction. The packed_... functions dispatch between
+// them.
+
+const size_t PACKED_WORD_BITS = 64;
+const uint64_t PACKED_EVEN_BITS = 0x5555555555555555ULL;
+const uint64_t PACKED_ODD_BITS = 0xAAAAAAAAAAAAAAAAULL;
+
+// Number of words needed to hold a row of total disks.
+size_t packed_word_count(size_t total) {
+  return (total + PACKED_WORD_BITS - 1) / PACKED_WORD_BITS;
+}
+
+// Mask of the bits in word k that are disk indices below limit.
+uint64_t packed_prefix_mask(size_t k, size_t limit) {
+  size_t first = k * PACKED_WORD_BITS;
+  if (limit <= first) {
+    return 0;
+  }
+  if (limit - first >= PACKED_WORD_BITS) {
+    return ~uint64_t(0);
+  }
+  return (uint64_t(1) << (limit - first)) - 1;
+}
+
+// Range of words [lo, hi) outside of which a row is already in its final
+// place: every word before lo is all dark and every word from hi on is all
+// light. Passes restricted to a window perform exactly the same swaps as
+// passes over the whole row.
+struct packed_window {
+  size_t lo, hi;
+
+  bool empty() const {
+    return lo >= hi;
+  }
+};
+
+// Shrink window past any all-dark words on the left and all-light words on
+// the right. Both ends only ever move inwards, so the total cost over a whole
+// sort is linear in the number of words.
+void packed_shrink_window(const uint64_t* words, size_t total, packed_window& window) {
+  while (window.lo < window.hi && words[window.lo] == 0) {
+    window.lo++;
+  }
+  while (window.hi > window.lo
+         && words[window.hi - 1] == packed_prefix_mask(window.hi - 1, total)) {
+    window.hi--;
+  }
+}
+
+// Whether words [begin, end) all equal pattern. Words are compared in blocks
+// of eight with no branch inside a block, so the compiler can vectorize each
+// block, and the scan stops at the first block that differs.
+bool packed_words_equal(const uint64_t* words, size_t begin, size_t end, uint64_t pattern) {
+  const size_t BLOCK = 8;
+  size_t k = begin;
+  for (; k + BLOCK <= end; k += BLOCK) {
+    uint64_t diff = 0;
+    for (size_t j = 0; j < BLOCK; ++j) {
+      diff |= words[k + j] ^ pattern;
+    }
+    if (diff) {
+      return false;
+    }
+  }
+  for (; k < end; ++k) {
+    if (words[k] != pattern) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Whether the row of total disks in words is light, dark, light, dark, ...
+// Every full word must equal PACKED_EVEN_BITS, and the last word the same
+// pattern cut off at the end of the row.
+bool packed_is_alternating(const uint64_t* words, size_t total) {
+  size_t full = total / PACKED_WORD_BITS;
+  if (!packed_words_equal(words, 0, full, PACKED_EVEN_BITS)) {
+    return false;
+  }
+  return (full == packed_word_count(total))
+         || words[full] == (PACKED_EVEN_BITS & packed_prefix_mask(full, total));
+}
+
+// Whether the row of total disks in words is all dark disks followed by all
+// light disks, in equal numbers: all-zero words up to the word holding disk
+// total / 2, then all-one words up to the end of the row.
+bool packed_is_sorted(const uint64_t* words, size_t total) {
+  size_t half = total / 2;
+  size_t boundary = half / PACKED_WORD_BITS;
+  size_t full = total / PACKED_WORD_BITS;
+  size_t count = packed_word_count(total);
+  if (!packed_words_equal(words, 0, boundary, 0)) {
+    return false;
+  }
+  if (boundary == count) {
+    return true;
+  }
+  if (words[boundary] != (packed_prefix_mask(boundary, total) & ~packed_prefix_mask(boundary, half))) {
+    return false;
+  }
+  if (!packed_words_equal(words, boundary + 1, std::max(boundary + 1, full), ~uint64_t(0))) {
+    return false;
+  }
+  return (full <= boundary) || (full == count)
+         || words[full] == packed_prefix_mask(full, total);
+}
+
+// A swap visitor is any callable taking the size_t left index of each swap,
+// called in the order an element-by-element pass would perform the swaps.
+// ignore_swaps is the default; the passes test visits_swaps at compile time,
+// so when no visitor is given the index reporting compiles away entirely.
+struct ignore_swaps {
+  void operator()(size_t) const { }
+};
+
+template <typename SwapVisitor>
+struct visits_swaps {
+  static const bool value = true;
+};
+
+template <>
+struct visits_swaps<ignore_swaps> {
+  static const bool value = false;
+};
+
+// Report each set bit of mask, as its disk index plus offset, in increasing
+// order or, when ascending is false, decreasing order.
+template <typename SwapVisitor>
+void visit_swap_bits(SwapVisitor& visit, uint64_t mask, size_t offset, bool ascending) {
+  while (mask) {
+    unsigned b = ascending ? __builtin_ctzll(mask) : 63 - __builtin_clzll(mask);
+    visit(offset + b);
+    mask ^= uint64_t(1) << b;
+  }
+}
+
+// Swap visitor that streams swap indices to an output stream as raw
+// little-endian 64-bit integers, through a fixed-size buffer, so logging
+// never allocates however many swaps there are. Call flush() (or destroy
+// the writer) once sorting is done.
+class swap_stream_writer {
+private:
+  static const size_t BUFFER_SIZE = 4096;
+  std::ostream& _out;
+  uint64_t _buffer[BUFFER_SIZE];
+  size_t _used;
+
+public:
+  swap_stream_writer(std::ostream& out)
+    : _out(out), _used(0) { }
+
+  ~swap_stream_writer() {
+    flush();
+  }
+
+  void operator()(size_t index) {
+    if (_used == BUFFER_SIZE) {
+      flush();
+    }
+    _buffer[_used++] = index;
+  }
+
+  void flush() {
+    _out.write(reinterpret_cast<const char*>(_buffer), _used * sizeof(uint64_t));
+    _used = 0;
+  }
+};
+
+// Swap every (light, dark) pair (i, i + 1) with i of the same parity as
+// first, i < pair_end, and i inside words [lo, hi). Word k + 1 is only read
+// or written when a pair straddles words k and k + 1.
+template <typename SwapVisitor = ignore_swaps>
+size_t scalar_alternate_pairs(uint64_t* words, size_t first,
+                              size_t lo, size_t hi, size_t pair_end,
+                              SwapVisitor&& visit = SwapVisitor()) {
+  assert(first < 2);
+  uint64_t left_bits = (first == 0) ? PACKED_EVEN_BITS : PACKED_ODD_BITS;
+  size_t swaps = 0;
+
+  for (size_t k = lo; k < hi; ++k) {
+    uint64_t candidates = left_bits & packed_prefix_mask(k, pair_end);
+    uint64_t w = words[k];
+    uint64_t next = (candidates >> 63) ? words[k + 1] : 0;
+    uint64_t right = (w >> 1) | (next << 63);     //bit b holds the disk to the right of bit b
+    uint64_t m = w & ~right & candidates;
+
+    words[k] = w ^ m ^ (m << 1);                  //swap every (light, dark) pair found
+    if (m >> 63) {
+      words[k + 1] ^= 1;                          //pair straddles two words
+    }
+    if (visits_swaps<typename std::decay<SwapVisitor>::type>::value) {
+      visit_swap_bits(visit, m, k * PACKED_WORD_BITS, true);
+    }
+    swaps += __builtin_popcountll(m);
+  }
+  return swaps;
+}
+
+// Forward (left to right) pass of the lawnmower algorithm over every pair.
+// A light disk is carried right until it meets another light disk, so every
+// dark disk with some light disk before it moves one place to the left.
+template <typename SwapVisitor = ignore_swaps>
+size_t scalar_lawnmower_forward_pass(uint64_t* words, size_t total,
+                                     packed_window window,
+                                     SwapVisitor&& visit = SwapVisitor()) {
+  if (window.empty()) {
+    return 0;
+  }
+
+  bool seen_light = false;                        //any light disk in words before k
+  uint64_t prev_dark = 0, prev_movers = 0;
+  size_t swaps = 0;
+
+  for (size_t k = window.lo; k < window.hi; ++k) {
+    uint64_t w = words[k];
+    uint64_t dark = ~w & packed_prefix_mask(k, total);
+    uint64_t after_light = seen_light ? ~uint64_t(0) : ~(((w & (0 - w)) << 1) - 1);
+    uint64_t movers = dark & after_light;
+
+    if (k > window.lo) {
+      uint64_t new_dark = (prev_dark & ~prev_movers) | (prev_movers >> 1) | (movers << 63);
+      words[k - 1] = ~new_dark;
+    }
+    seen_light = seen_light || (w != 0);
+    prev_dark = dark;
+    prev_movers = movers;
+    if (visits_swaps<typename std::decay<SwapVisitor>::type>::value) {
+      visit_swap_bits(visit, movers, k * PACKED_WORD_BITS - 1, true);   //dark disk at i swaps with i - 1
+    }
+    swaps += __builtin_popcountll(movers);
+  }
+
+  uint64_t new_dark = (prev_dark & ~prev_movers) | (prev_movers >> 1);
+  words[window.hi - 1] = ~new_dark & packed_prefix_mask(window.hi - 1, total);
+  return swaps;
+}
+
+// Backward (right to left) pass of the lawnmower algorithm over the pairs
+// (i - 1, i) for 1 <= i <= total - 2, so the rightmost disk is left alone.
+// Every light disk with some dark disk after it in that range moves one
+// place to the right.
+template <typename SwapVisitor = ignore_swaps>
+size_t scalar_lawnmower_backward_pass(uint64_t* words, size_t total,
+                                      packed_window window,
+                                      SwapVisitor&& visit = SwapVisitor()) {
+  if (window.empty()) {
+    return 0;
+  }
+
+  bool seen_dark = false;                         //any dark disk in words after k
+  uint64_t prev_light = 0, prev_movers = 0;
+  size_t swaps = 0;
+
+  for (size_t k = window.hi; k-- > window.lo; ) {
+    uint64_t w = words[k];
+    uint64_t in_range = packed_prefix_mask(k, total - 1);
+    uint64_t dark = ~w & in_range;
+    uint64_t before_dark = seen_dark ? ~uint64_t(0)
+      : (dark ? (uint64_t(1) << (63 - __builtin_clzll(dark))) - 1 : 0);
+    uint64_t movers = w & in_range & before_dark;
+
+    if (k + 1 < window.hi) {
+      words[k + 1] = (prev_light & ~prev_movers) | (prev_movers << 1) | (movers >> 63);
+    }
+    seen_dark = seen_dark || (dark != 0);
+    prev_light = w;
+    prev_movers = movers;
+    if (visits_swaps<typename std::decay<SwapVisitor>::type>::value) {
+      visit_swap_bits(visit, movers, k * PACKED_WORD_BITS, false);
+    }
+    swaps += __builtin_popcountll(movers);
+  }
+
+  words[window.lo] = (prev_light & ~prev_movers) | (prev_movers << 1);
+  return swaps;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DISKS_HAVE_AVX2 1
+#include <immintrin.h>
+
+// Number of set bits in each 64-bit lane of v, using a 4-bit lookup table.
+__attribute__((target("avx2")))
+__m256i avx2_popcount_lanes(__m256i v) {
+  const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                         0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low_nibbles = _mm256_set1_epi8(0x0F);
+  __m256i low = _mm256_and_si256(v, low_nibbles);
+  __m256i high = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_nibbles);
+  __m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(table, low),
+                                   _mm256_shuffle_epi8(table, high));
+  return _mm256_sad_epu8(counts, _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2")))
+size_t avx2_sum_lanes(__m256i v) {
+  return _mm256_extract_epi64(v, 0) + _mm256_extract_epi64(v, 1)
+    + _mm256_extract_epi64(v, 2) + _mm256_extract_epi64(v, 3);
+}
+
+// AVX2 version of scalar_alternate_pairs. Pairs straddling two words inside
+// a vector are handled by rotating the carry bits up one lane; the carry out
+// of the last lane is applied to the next word before it is loaded.
+__attribute__((target("avx2")))
+size_t avx2_alternate_pairs(uint64_t* words, size_t first,
+                            size_t lo, size_t hi, size_t pair_end) {
+  assert(first < 2);
+  const __m256i left_bits = _mm256_set1_epi64x(
+    (first == 0) ? PACKED_EVEN_BITS : PACKED_ODD_BITS);
+  __m256i swaps = _mm256_setzero_si256();
+  size_t k = lo;
+
+  for (; k + 4 < hi && (k + 4) * PACKED_WORD_BITS <= pair_end; k += 4) {
+    __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + k));
+    __m256i right = _mm256_srli_epi64(w, 1);
+    if (first == 1) {
+      __m256i next = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + k + 1));
+      right = _mm256_or_si256(right, _mm256_slli_epi64(next, 63));
+    }
+    __m256i m = _mm256_and_si256(_mm256_andnot_si256(right, w), left_bits);
+    __m256i carry = _mm256_srli_epi64(m, 63);
+    __m256i carry_in = _mm256_blend_epi32(
+      _mm256_permute4x64_epi64(carry, _MM_SHUFFLE(2, 1, 0, 3)), _mm256_setzero_si256(), 0x03);
+
+    w = _mm256_xor_si256(w, _mm256_xor_si256(m, _mm256_slli_epi64(m, 1)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(words + k), _mm256_xor_si256(w, carry_in));
+    words[k + 4] ^= _mm256_extract_epi64(carry, 3);
+    swaps = _mm256_add_epi64(swaps, avx2_popcount_lanes(m));
+  }
+  return avx2_sum_lanes(swaps) + scalar_alternate_pairs(words, first, k, hi, pair_end);
+}
+
+// AVX2 version of scalar_lawnmower_forward_pass. Every dark disk after the
+// word holding the first light disk moves, so past that word the pass is a
+// one-bit funnel shift of the whole row.
+__attribute__((target("avx2")))
+size_t avx2_lawnmower_forward_pass(uint64_t* words, size_t total,
+                                   packed_window window) {
+  size_t f = window.lo;
+  while (f < window.hi && words[f] == 0) {
+    f++;
+  }
+  if (f == window.hi) {
+    return 0;
+  }
+
+  uint64_t w = words[f];
+  uint64_t dark = ~w & packed_prefix_mask(f, total);
+  uint64_t movers = dark & ~(((w & (0 - w)) << 1) - 1);
+  uint64_t next_dark = (f + 1 < window.hi) ? ~words[f + 1] & packed_prefix_mask(f + 1, total) : 0;
+  words[f] = ~((dark & ~movers) | (movers >> 1) | (next_dark << 63)) & packed_prefix_mask(f, total);
+
+  size_t k = f + 1;
+  __m256i swaps = _mm256_setzero_si256();
+  for (; k + 4 < window.hi; k += 4) {
+    __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + k));
+    __m256i next = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + k + 1));
+    d = _mm256_xor_si256(d, _mm256_set1_epi64x(-1));
+    next = _mm256_xor_si256(next, _mm256_set1_epi64x(-1));
+    __m256i new_dark = _mm256_or_si256(_mm256_srli_epi64(d, 1), _mm256_slli_epi64(next, 63));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(words + k), _mm256_xor_si256(new_dark, _mm256_set1_epi64x(-1)));
+    swaps = _mm256_add_epi64(swaps, avx2_popcount_lanes(d));
+  }
+
+  size_t count = __builtin_popcountll(movers) + avx2_sum_lanes(swaps);
+  for (; k < window.hi; ++k) {
+    dark = ~words[k] & packed_prefix_mask(k, total);
+    next_dark = (k + 1 < window.hi) ? ~words[k + 1] & packed_prefix_mask(k + 1, total) : 0;
+    words[k] = ~((dark >> 1) | (next_dark << 63)) & packed_prefix_mask(k, total);
+    count += __builtin_popcountll(dark);
+  }
+  return count;
+}
+
+// AVX2 version of scalar_lawnmower_backward_pass: the mirror image of
+// avx2_lawnmower_forward_pass, shifting light disks right before the word
+// holding the last dark disk.
+__attribute__((target("avx2")))
+size_t avx2_lawnmower_backward_pass(uint64_t* words, size_t total,
+                                    packed_window window) {
+  size_t g = window.hi;
+  while (g > window.lo && (~words[g - 1] & packed_prefix_mask(g - 1, total - 1)) == 0) {
+    g--;
+  }
+  if (g == window.lo) {
+    return 0;
+  }
+  g--;
+
+  uint64_t w = words[g];
+  uint64_t dark = ~w & packed_prefix_mask(g, total - 1);
+  uint64_t movers = w & ((uint64_t(1) << (63 - __builtin_clzll(dark))) - 1);
+  uint64_t prev_light = (g > window.lo) ? words[g - 1] : 0;
+  words[g] = (w & ~movers) | (movers << 1) | (prev_light >> 63);
+
+  size_t k = g;                                   //words [window.lo, k) are left to do
+  __m256i swaps = _mm256_setzero_si256();
+  for (; k >= window.lo + 5; k -= 4) {
+    __m256i light = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + k - 4));
+    __m256i prev = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + k - 5));
+    __m256i new_light = _mm256_or_si256(_mm256_slli_epi64(light, 1), _mm256_srli_epi64(prev, 63));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(words + k - 4), new_light);
+    swaps = _mm256_add_epi64(swaps, avx2_popcount_lanes(light));
+  }
+
+  size_t count = __builtin_popcountll(movers) + avx2_sum_lanes(swaps);
+  for (; k > window.lo; --k) {
+    uint64_t light = words[k - 1];
+    prev_light = (k - 1 > window.lo) ? words[k - 2] : 0;
+    words[k - 1] = (light << 1) | (prev_light >> 63);
+    count += __builtin_popcountll(light);
+  }
+  return count;
+}
+#endif
+
+// Implementation used for the bulk passes. BACKEND_AUTO picks AVX2 when the
+// processor supports it; BACKEND_AVX2 falls back to scalar code when it
+// does not.
+enum disk_backend { BACKEND_AUTO, BACKEND_SCALAR, BACKEND_AVX2 };
+
+// Return true when this processor can run the AVX2 kernels.
+bool avx2_supported() {
+#ifdef DISKS_HAVE_AVX2
+  return __builtin_cpu_supports("avx2");
+#else
+  return false;
+#endif
+}
+
+// Turn BACKEND_AUTO, or an unsupported backend, into one that can run here.
+disk_backend resolve_backend(disk_backend backend) {
+  if (backend != BACKEND_SCALAR && avx2_supported()) {
+    return BACKEND_AVX2;
+  }
+  return BACKEND_SCALAR;
+}
+
+// Dispatch each pass to the chosen backend. Passes given a swap visitor
+// always run on the scalar backend, since only it reports swap indices.
+template <typename SwapVisitor = ignore_swaps>
+size_t packed_alternate_pairs(uint64_t* words, size_t first, size_t lo, size_t hi,
+                              size_t pair_end, disk_backend backend = BACKEND_AUTO,
+                              SwapVisitor&& visit = SwapVisitor()) {
+#ifdef DISKS_HAVE_AVX2
+  if (!visits_swaps<typename std::decay<SwapVisitor>::type>::value
+      && resolve_backend(backend) == BACKEND_AVX2) {
+    return avx2_alternate_pairs(words, first, lo, hi, pair_end);
+  }
+#endif
+  return scalar_alternate_pairs(words, first, lo, hi, pair_end, visit);
+}
+
+// One pass of the alternate algorithm: every pair (i, i + 1) with i of the
+// same parity as first is swapped when it is (light, dark).
+template <typename SwapVisitor = ignore_swaps>
+size_t packed_alternate_pass(uint64_t* words, size_t total, size_t first,
+                             packed_window window, disk_backend backend = BACKEND_AUTO,
+                             SwapVisitor&& visit = SwapVisitor()) {
+  return packed_alternate_pairs(words, first, window.lo, window.hi, total - 1, backend, visit);
+}
+
+template <typename SwapVisitor = ignore_swaps>
+size_t packed_lawnmower_forward_pass(uint64_t* words, size_t total, packed_window window,
+                                     disk_backend backend = BACKEND_AUTO,
+                                     SwapVisitor&& visit = SwapVisitor()) {
+#ifdef DISKS_HAVE_AVX2
+  if (!visits_swaps<typename std::decay<SwapVisitor>::type>::value
+      && resolve_backend(backend) == BACKEND_AVX2) {
+    return avx2_lawnmower_forward_pass(words, total, window);
+  }
+#endif
+  return scalar_lawnmower_forward_pass(words, total, window, visit);
+}
+
+template <typename SwapVisitor = ignore_swaps>
+size_t packed_lawnmower_backward_pass(uint64_t* words, size_t total, packed_window window,
+                                      disk_backend backend = BACKEND_AUTO,
+                                      SwapVisitor&& visit = SwapVisitor()) {
+#ifdef DISKS_HAVE_AVX2
+  if (!visits_swaps<typename std::decay<SwapVisitor>::type>::value
+      && resolve_backend(backend) == BACKEND_AVX2) {
+    return avx2_lawnmower_backward_pass(words, total, window);
+  }
+#endif
+  return scalar_lawnmower_backward_pass(words, total, window, visit);
+}
+
 class disk_state {
 private:
-  std::vector<disk_color> _colors;
+  size_t _total;
+  std::vector<uint64_t> _words;
+
+  void flip(size_t index) {
+    _words[index / PACKED_WORD_BITS] ^= uint64_t(1) << (index % PACKED_WORD_BITS);
+  }
+
+  // Take ownership of already packed words; used by the factory functions.
+  // Throws std::invalid_argument unless the row holds the same, positive,
+  // number of light and dark disks.
+  disk_state(size_t total, std::vector<uint64_t>&& words)
+    : _total(total), _words(std::move(words)) {
+
+    assert(_words.size() == packed_word_count(total));
+
+    size_t lights = 0;
+    for (auto w : _words) {
+      lights += __builtin_popcountll(w);
+    }
+    if (total == 0 || lights * 2 != total) {
+      throw std::invalid_argument("disk_state needs equal, positive numbers of light and dark disks");
+    }
+  }
+
+  // Text for each byte of a packed word: the 8 disks it holds, in order,
+  // each followed by a space.
+  static const char* text_table() {
+    static char table[256 * 16];
+    static bool built = [] {
+      for (unsigned b = 0; b < 256; ++b) {
+        for (unsigned j = 0; j < 8; ++j) {
+          table[b * 16 + j * 2] = ((b >> j) & 1) ? 'L' : 'D';
+          table[b * 16 + j * 2 + 1] = ' ';
+        }
+      }
+      return true;
+    }();
+    (void)built;
+    return table;
+  }
+
+  // Write the text of disks [begin, end) to out, eight disks per table
+  // lookup, and return the end of the text written. Every disk but the
+  // last in the row is followed by a space.
+  char* write_text_range(size_t begin, size_t end, char* out) const {
+    const char* table = text_table();
+    size_t i = begin;
+    for (; i < end && i % 8 != 0; ++i) {
+      *out++ = (get(i) == DISK_LIGHT) ? 'L' : 'D';
+      *out++ = ' ';
+    }
+    for (; i + 8 < end || (i + 8 == end && end < _total); i += 8) {
+      unsigned byte = (_words[i / PACKED_WORD_BITS] >> (i % PACKED_WORD_BITS)) & 0xFF;
+      std::memcpy(out, table + byte * 16, 16);
+      out += 16;
+    }
+    for (; i < end; ++i) {
+      *out++ = (get(i) == DISK_LIGHT) ? 'L' : 'D';
+      if (i + 1 < _total) {
+        *out++ = ' ';
+      }
+    }
+    return out;
+  }
 
 public:
   disk_state(size_t light_count)
-    : _colors(light_count * 2, DISK_DARK) {
+    : _total(light_count * 2),
+      _words(packed_word_count(light_count * 2), PACKED_EVEN_BITS) {
+
+    assert(light_count > 0);
+
+    if (!_words.empty()) {                        //light_count 0 leaves an empty row, as it always has
+      _words.back() &= packed_prefix_mask(_words.size() - 1, _total);
+    }
+  }
+
+  // Factory functions for other initial layouts. All of them build the
+  // packed words directly, in O(n) time. Like the constructor, they assert
+  // that light_count is positive, and return an empty row for 0 when
+  // assertions are off.
+
+  // Uniformly random arrangement of light_count light and light_count dark
+  // disks, determined by seed. Uses selection sampling: each position is
+  // light with probability (lights left) / (positions left).
+  static disk_state random(size_t light_count, uint64_t seed) {
+    assert(light_count > 0);
+    if (light_count == 0) {
+      return disk_state(0);
+    }
+    size_t total = light_count * 2;
+    std::vector<uint64_t> words(packed_word_count(total), 0);
+    std::mt19937_64 rng(seed);
+    size_t lights_left = light_count;
+
+    for (size_t i = 0; i < total && lights_left > 0; ++i) {
+      unsigned __int128 draw = static_cast<unsigned __int128>(rng()) * (total - i);
+      if (static_cast<size_t>(draw >> 64) < lights_left) {   //draw is uniform in [0, total - i)
+        words[i / PACKED_WORD_BITS] |= uint64_t(1) << (i % PACKED_WORD_BITS);
+        lights_left--;
+      }
+    }
+    return disk_state(total, std::move(words));
+  }
+
+  // Parse the output of to_string(): one 'L' or 'D' per disk, with any
+  // whitespace between them ignored. Throws std::invalid_argument on any
+  // other character, or when the light and dark counts differ.
+  static disk_state from_string(const std::string& text) {
+    return from_text(text.data(), text.size());
+  }
+
+  // Parse length characters of text in the format of from_string, without
+  // copying them first, so text can point straight into a memory-mapped
+  // file. Disks are collected into a register and stored a word at a time.
+  // Runs of the exact format to_string() writes are parsed eight disks (16
+  // characters) at a time; anything else falls back to one character at a
+  // time.
+  static disk_state from_text(const char* text, size_t length) {
+    std::vector<uint64_t> words(packed_word_count(length), 0);
+    size_t total = 0;
+    uint64_t word = 0;
+    for (size_t i = 0; i < length; ++i) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+      while (total % 8 == 0 && i + 16 <= length) {
+        uint64_t half[2];
+        std::memcpy(half, text + i, 16);
+        unsigned disks = 0;
+        bool canonical = true;
+        for (unsigned h = 0; h < 2; ++h) {
+          // 'L' and 'D' differ only in bit 3, so each letter byte must be
+          // 0x4C once that bit is set, and each other byte a space.
+          canonical = canonical
+                      && (half[h] & 0xFF00FF00FF00FF00ULL) == 0x2000200020002000ULL
+                      && ((half[h] | 0x0008000800080008ULL) & 0x00FF00FF00FF00FFULL) == 0x004C004C004C004CULL;
+          uint64_t bits = (half[h] >> 3) & 0x0001000100010001ULL;
+          disks |= ((bits | (bits >> 15) | (bits >> 30) | (bits >> 45)) & 0xF) << (4 * h);
+        }
+        if (!canonical) {
+          break;
+        }
+        word |= uint64_t(disks) << (total % PACKED_WORD_BITS);
+        total += 8;
+        i += 16;
+        if (total % PACKED_WORD_BITS == 0) {
+          words[total / PACKED_WORD_BITS - 1] = word;
+          word = 0;
+        }
+      }
+      if (i == length) {
+        break;
+      }
+#endif
+      char c = text[i];
+      if (c == 'L') {
+        word |= uint64_t(1) << (total % PACKED_WORD_BITS);
+      } else if (c != 'D') {
+        if (!std::isspace(static_cast<unsigned char>(c))) {
+          throw std::invalid_argument(std::string("invalid disk color '") + c + "'");
+        }
+        continue;
+      }
+      if (++total % PACKED_WORD_BITS == 0) {
+        words[total / PACKED_WORD_BITS - 1] = word;
+        word = 0;
+      }
+    }
+    if (total % PACKED_WORD_BITS != 0) {
+      words[total / PACKED_WORD_BITS] = word;
+    }
+    words.resize(packed_word_count(total));
+    return disk_state(total, std::move(words));
+  }
+
+  // Copy a row of total disks from a packed bitmap in the same layout as
+  // word_data(). Bits past the end of the row are ignored.
+  static disk_state from_bitmap(const uint64_t* bitmap, size_t total) {
+    std::vector<uint64_t> words(bitmap, bitmap + packed_word_count(total));
+    if (!words.empty()) {
+      words.back() &= packed_prefix_mask(words.size() - 1, total);
+    }
+    return disk_state(total, std::move(words));
+  }
 
+  // Every light disk before every dark disk: the most inversions possible.
+  // Note that the fixed pass budgets of sort_alternate and sort_lawnmower
+  // do not fully sort this layout.
+  static disk_state worst_case(size_t light_count) {
     assert(light_count > 0);
+    if (light_count == 0) {
+      return disk_state(0);
+    }
+    size_t total = light_count * 2;
+    std::vector<uint64_t> words(packed_word_count(total));
+    for (size_t k = 0; k < words.size(); ++k) {
+      words[k] = packed_prefix_mask(k, light_count);
+    }
+    return disk_state(total, std::move(words));
+  }
 
-    for (size_t i = 0; i < _colors.size(); i += 2) {
-      _colors[i] = DISK_LIGHT;
+  // Already sorted, so no swaps are needed.
+  static disk_state best_case(size_t light_count) {
+    assert(light_count > 0);
+    if (light_count == 0) {
+      return disk_state(0);
     }
+    size_t total = light_count * 2;
+    std::vector<uint64_t> words(packed_word_count(total));
+    for (size_t k = 0; k < words.size(); ++k) {
+      words[k] = packed_prefix_mask(k, total) & ~packed_prefix_mask(k, light_count);
+    }
+    return disk_state(total, std::move(words));
   }
 
   bool operator== (const disk_state& rhs) const {
-    return std::equal(_colors.begin(), _colors.end(), rhs._colors.begin());
+    return (_total == rhs._total) && (_words == rhs._words);
   }
 
   size_t total_count() const {
-    return _colors.size();
+    return _total;
   }
 
   size_t light_count() const {
@@ -61,76 +768,167 @@ public:
 
   disk_color get(size_t index) const {
     assert(is_index(index));
-    return _colors[index];
+    uint64_t bit = _words[index / PACKED_WORD_BITS] >> (index % PACKED_WORD_BITS);
+    return (bit & 1) ? DISK_LIGHT : DISK_DARK;
   }
 
   void swap(size_t left_index) {
     assert(is_index(left_index));
     auto right_index = left_index + 1;
     assert(is_index(right_index));
-    std::swap(_colors[left_index], _colors[right_index]);
+    if (get(left_index) != get(right_index)) {
+      flip(left_index);
+      flip(right_index);
+    }
   }
 
-  std::string to_string() const {
-    std::stringstream ss;
-    bool first = true;
-    for (auto color : _colors) {
-      if (!first) {
-        ss << " ";
-      }
+  // Direct access to the packed words, for code that runs its own passes.
+  size_t word_count() const {
+    return _words.size();
+  }
+
+  uint64_t* word_data() {
+    return _words.data();
+  }
+
+  const uint64_t* word_data() const {
+    return _words.data();
+  }
+
+  // Window covering every word of the row.
+  packed_window full_window() const {
+    packed_window window = { 0, _words.size() };
+    return window;
+  }
+
+  // Shrink window to the part of the row that is not yet in place.
+  void shrink_window(packed_window& window) const {
+    packed_shrink_window(_words.data(), _total, window);
+  }
+
+  // Bulk passes over the row, or only over the words in window, using the
+  // given backend and optional swap visitor; see the packed_... functions
+  // above. Each returns the number of swaps performed.
+  template <typename SwapVisitor = ignore_swaps>
+  size_t alternate_pass(size_t first, disk_backend backend = BACKEND_AUTO,
+                        SwapVisitor&& visit = SwapVisitor()) {
+    return alternate_pass(first, full_window(), backend, visit);
+  }
+
+  template <typename SwapVisitor = ignore_swaps>
+  size_t alternate_pass(size_t first, const packed_window& window,
+                        disk_backend backend = BACKEND_AUTO,
+                        SwapVisitor&& visit = SwapVisitor()) {
+    return packed_alternate_pass(_words.data(), _total, first, window, backend, visit);
+  }
+
+  template <typename SwapVisitor = ignore_swaps>
+  size_t lawnmower_forward_pass(disk_backend backend = BACKEND_AUTO,
+                                SwapVisitor&& visit = SwapVisitor()) {
+    return lawnmower_forward_pass(full_window(), backend, visit);
+  }
+
+  template <typename SwapVisitor = ignore_swaps>
+  size_t lawnmower_forward_pass(const packed_window& window,
+                                disk_backend backend = BACKEND_AUTO,
+                                SwapVisitor&& visit = SwapVisitor()) {
+    return packed_lawnmower_forward_pass(_words.data(), _total, window, backend, visit);
+  }
+
+  template <typename SwapVisitor = ignore_swaps>
+  size_t lawnmower_backward_pass(disk_backend backend = BACKEND_AUTO,
+                                 SwapVisitor&& visit = SwapVisitor()) {
+    return lawnmower_backward_pass(full_window(), backend, visit);
+  }
 
-      if (color == DISK_LIGHT) {
-        ss << "L";
-      } else {
-        ss << "D";
+  template <typename SwapVisitor = ignore_swaps>
+  size_t lawnmower_backward_pass(const packed_window& window,
+                                 disk_backend backend = BACKEND_AUTO,
+                                 SwapVisitor&& visit = SwapVisitor()) {
+    return packed_lawnmower_backward_pass(_words.data(), _total, window, backend, visit);
+  }
+
+  // Return the number of inversions, i.e. pairs of disks where a light disk
+  // is somewhere to the left of a dark disk. Every adjacent swap of a (light, dark)
+  // pair removes exactly one of these, so this is the number of swaps any
+  // adjacent-swap algorithm performs on the way to the sorted row.
+  //
+  // The count is the sum, over dark disks, of the light disks before it,
+  // which equals (sum of dark positions) - D(D - 1) / 2 for D dark disks.
+  // Dark positions are summed a word at a time, one bit of the position
+  // index per popcount.
+  uint64_t inversion_count() const {
+    static const uint64_t index_bit_masks[6] = {
+      0xAAAAAAAAAAAAAAAAULL, 0xCCCCCCCCCCCCCCCCULL, 0xF0F0F0F0F0F0F0F0ULL,
+      0xFF00FF00FF00FF00ULL, 0xFFFF0000FFFF0000ULL, 0xFFFFFFFF00000000ULL
+    };
+    uint64_t position_sum = 0, darks = 0;
+    for (size_t k = 0; k < _words.size(); ++k) {
+      uint64_t dark = ~_words[k] & packed_prefix_mask(k, _total);
+      uint64_t count = __builtin_popcountll(dark);
+      position_sum += count * (k * PACKED_WORD_BITS);
+      for (unsigned b = 0; b < 6; ++b) {
+        position_sum += uint64_t(__builtin_popcountll(dark & index_bit_masks[b])) << b;
       }
+      darks += count;
+    }
+    return position_sum - (darks * (darks - 1)) / 2;
+  }
 
-      first = false;
+  // Overwrite the row with its sorted layout: every dark disk on the left,
+  // every light disk on the right.
+  void set_sorted() {
+    size_t darks = 0;
+    for (size_t k = 0; k < _words.size(); ++k) {
+      darks += __builtin_popcountll(~_words[k] & packed_prefix_mask(k, _total));
+    }
+    for (size_t k = 0; k < _words.size(); ++k) {
+      _words[k] = packed_prefix_mask(k, _total) & ~packed_prefix_mask(k, darks);
+    }
+  }
+
+  // Length of the text written by to_string() and write_text(): one letter
+  // per disk with a space between each pair of disks.
+  size_t text_size() const {
+    return 2 * _total - 1;
+  }
+
+  std::string to_string() const {
+    std::string text(text_size(), ' ');
+    write_text(&text[0]);
+    return text;
+  }
+
+  // Write the text of to_string() into buffer, which must hold at least
+  // text_size() characters; no terminating null is added. Returns the
+  // number of characters written.
+  size_t write_text(char* buffer) const {
+    return write_text_range(0, _total, buffer) - buffer;
+  }
+
+  // Write the text of to_string() to out, in chunks through a fixed-size
+  // buffer, so huge rows are never held in memory as text all at once.
+  void write_text(std::ostream& out) const {
+    const size_t CHUNK_DISKS = 4096;
+    char buffer[2 * CHUNK_DISKS];
+    for (size_t begin = 0; begin < _total; begin += CHUNK_DISKS) {
+      size_t end = std::min(_total, begin + CHUNK_DISKS);
+      out.write(buffer, write_text_range(begin, end, buffer) - buffer);
     }
-    return ss.str();
   }
 
   // Return true when this disk_state is in alternating format. That means
   // that the first disk at index 0 is light, the second disk at index 1
   // is dark, and so on for the entire row of disks.
   bool is_initialized() const {
-    for (size_t i = 0; i < _colors.size(); ++i)       //for loop to iterate each disk
-    {
-      if (i % 2 == 0 && _colors[i] != DISK_LIGHT)     //check if disk at index 0 and even indexes are light, return false otherwise
-      {
-        return false;
-      }
-      else if (i % 2 == 1 && _colors[i] != DISK_DARK) //check if disk at index 1 and odd indexes are dark, return false otherwise
-      {
-        return false;
-      }
-    }
-    return true;
+    return packed_is_alternating(_words.data(), _total);
   }
 
   // Return true when this disk_state is fully sorted, with all dark disks
   // on the left (low indices) and all light disks on the right (high
   // indices).
   bool is_sorted() const {
-    int n = total_count();    //stores the total number of disks
-    int begin_light = n/2;    //stores the index where light disks started
-
-    for (int i = 0; i < begin_light; ++i)   //iterate every disk starting from index 0 to the one before light disks started
-    {                                 
-      if (_colors[i] != DISK_DARK)          //check if disk color is dark, return false otherwise
-      {
-        return false;
-      }
-    }
-
-    for (int i = begin_light; i < n; ++i)   //iterate every disk starting from index where light disks started to the end
-    {
-      if(_colors[i] != DISK_LIGHT)          //check if disk color is light, return false otherwise
-      {
-        return false;
-      }
-    }
-    return true;
+    return packed_is_sorted(_words.data(), _total);
   }
 };
 
@@ -140,86 +938,449 @@ public:
 class sorted_disks {
 private:
   disk_state _after;
-  unsigned _swap_count;
+  uint64_t _swap_count;
   
 public:
   
-  sorted_disks(const disk_state& after, unsigned swap_count)
+  sorted_disks(const disk_state& after, uint64_t swap_count)
     : _after(after), _swap_count(swap_count) { }
   
-  sorted_disks(disk_state&& after, unsigned swap_count)
-    : _after(after), _swap_count(swap_count) { }
+  sorted_disks(disk_state&& after, uint64_t swap_count)
+    : _after(std::move(after)), _swap_count(swap_count) { }
   
   const disk_state& after() const {
     return _after;
   }
   
-  unsigned swap_count() const {
+  uint64_t swap_count() const {
     return _swap_count;
   }
 };
 
-// Algorithm that sorts disks using the alternate algorithm.
-sorted_disks sort_alternate(const disk_state& before) {
+// Number of passes sort_alternate and sort_lawnmower make over a row of
+// total disks: one per light disk, rounded up to a whole number of pairs.
+size_t sort_pass_count(size_t total) {
+  size_t n = (total / 2);             //total number of runs to be executed
+  return n + n % 2;                   //runs are always executed in pairs
+}
+
+// A pass statistics policy is told about every pass a sorter makes:
+// begin_pass(pass) just before it, and end_pass(pass, compares, swaps) just
+// after, where compares is the number of adjacent pairs the equivalent
+// element-by-element pass would compare. no_pass_stats is the default;
+// records_pass_stats is tested at compile time, so without a policy the
+// calls compile away entirely. See pass_stats in disks_stats.hpp.
+struct no_pass_stats {
+  void begin_pass(size_t) const { }
+  void end_pass(size_t, uint64_t, uint64_t) const { }
+};
+
+template <typename PassStats>
+struct records_pass_stats {
+  static const bool value = true;
+};
+
+template <>
+struct records_pass_stats<no_pass_stats> {
+  static const bool value = false;
+};
+
+// Run passes [begin_pass, end_pass) of the alternate algorithm on the total
+// disks packed in words, in place, and return the number of swaps
+// performed. Even passes start from the leftmost disk and odd passes from
+// the second leftmost, so a sort can be split into several calls, for
+// example to checkpoint it between them.
+template <typename SwapVisitor = ignore_swaps, typename PassStats = no_pass_stats>
+uint64_t packed_alternate_passes(uint64_t* words, size_t total,
+                                 size_t begin_pass, size_t end_pass,
+                                 disk_backend backend = BACKEND_AUTO,
+                                 SwapVisitor&& visit = SwapVisitor(),
+                                 PassStats&& stats = PassStats()) {
+  const bool recording = records_pass_stats<typename std::decay<PassStats>::type>::value;
+  backend = resolve_backend(backend);
+  packed_window window = { 0, packed_word_count(total) };
+  uint64_t count_swaps = 0;           //stores count of swaps performed
+
+  for (size_t a = begin_pass; a < end_pass; ++a)
+  {
+    if (recording) {
+      stats.begin_pass(a);
+    }
+    size_t swaps = packed_alternate_pass(words, total, a % 2, window, backend, visit);  //swaps every (light, dark) pair of this run's parity, 64 pairs per word
+    count_swaps += swaps;
+    if (recording) {
+      stats.end_pass(a, (total - a % 2) / 2, swaps);
+    }
+  }
+  return count_swaps;
+}
+
+// Run passes [begin_pass, end_pass) of the lawnmower algorithm: even passes
+// go forward from the leftmost disk, odd passes backward from the disk
+// before the rightmost.
+template <typename SwapVisitor = ignore_swaps, typename PassStats = no_pass_stats>
+uint64_t packed_lawnmower_passes(uint64_t* words, size_t total,
+                                 size_t begin_pass, size_t end_pass,
+                                 disk_backend backend = BACKEND_AUTO,
+                                 SwapVisitor&& visit = SwapVisitor(),
+                                 PassStats&& stats = PassStats()) {
+  const bool recording = records_pass_stats<typename std::decay<PassStats>::type>::value;
+  backend = resolve_backend(backend);
+  packed_window window = { 0, packed_word_count(total) };
+  uint64_t count_swaps = 0;           //stores count of swaps performed
+
+  for (size_t a = begin_pass; a < end_pass; ++a)
+  {
+    if (recording) {
+      stats.begin_pass(a);
+    }
+    size_t swaps;
+    if (a % 2 == 0) {
+      swaps = packed_lawnmower_forward_pass(words, total, window, backend, visit);   //compares pairs (0, 1) to (total - 2, total - 1)
+    } else {
+      swaps = packed_lawnmower_backward_pass(words, total, window, backend, visit);  //compares pairs (total - 3, total - 2) down to (0, 1)
+    }
+    count_swaps += swaps;
+    if (recording) {
+      stats.end_pass(a, (a % 2 == 0) ? total - 1 : total - 2, swaps);
+    }
+  }
+  return count_swaps;
+}
+
+// Algorithm that sorts the total disks packed in words using the alternate
+// algorithm, in place, and returns the number of swaps performed. This is
+// the core of sort_alternate_inplace, for callers that keep rows in their
+// own storage.
+template <typename SwapVisitor = ignore_swaps, typename PassStats = no_pass_stats>
+uint64_t packed_sort_alternate(uint64_t* words, size_t total,
+                               disk_backend backend = BACKEND_AUTO,
+                               SwapVisitor&& visit = SwapVisitor(),
+                               PassStats&& stats = PassStats()) {
+  return packed_alternate_passes(words, total, 0, sort_pass_count(total), backend, visit, stats);
+}
+
+// Algorithm that sorts the total disks packed in words using the lawnmower
+// algorithm, in place; the core of sort_lawnmower_inplace.
+template <typename SwapVisitor = ignore_swaps, typename PassStats = no_pass_stats>
+uint64_t packed_sort_lawnmower(uint64_t* words, size_t total,
+                               disk_backend backend = BACKEND_AUTO,
+                               SwapVisitor&& visit = SwapVisitor(),
+                               PassStats&& stats = PassStats()) {
+  return packed_lawnmower_passes(words, total, 0, sort_pass_count(total), backend, visit, stats);
+}
+
+// Algorithm that sorts disks using the alternate algorithm, in place:
+// row is sorted directly and the number of swaps performed is returned,
+// so no copy of the row is ever made.
+//
+// When visit is given, it is called with the left index of every swap, in
+// the order the swaps are performed (see ignore_swaps). Nothing is stored,
+// so a visitor can stream the swaps of very long rows out to a file.
+// Likewise stats, when given, hears about every pass (see no_pass_stats).
+template <typename SwapVisitor, typename PassStats = no_pass_stats>
+uint64_t sort_alternate_inplace(disk_state& row, SwapVisitor&& visit,
+                                disk_backend backend = BACKEND_AUTO,
+                                PassStats&& stats = PassStats()) {
+  return packed_sort_alternate(row.word_data(), row.total_count(), backend, visit, stats);
+}
+
+uint64_t sort_alternate_inplace(disk_state& row, disk_backend backend = BACKEND_AUTO) {
+  return sort_alternate_inplace(row, ignore_swaps(), backend);
+}
+
+// Algorithm that sorts disks using the alternate algorithm, leaving before
+// untouched. The sorted copy is moved into the result.
+template <typename SwapVisitor, typename PassStats = no_pass_stats>
+sorted_disks sort_alternate(const disk_state& before, SwapVisitor&& visit,
+                            disk_backend backend = BACKEND_AUTO,
+                            PassStats&& stats = PassStats()) {
   disk_state after = before;          //make a copy of the disk
-  int n = (after.total_count() / 2);  //total number of runs to be executed
-  int a = 0;                          //stores number of runs
-  int count_swaps = 0;                //stores count of swaps performed
+  uint64_t count_swaps = sort_alternate_inplace(after, visit, backend, stats);
+  return sorted_disks(std::move(after), count_swaps);  //return the sorted disk with dark disks on the left side and light disks on the right side, including total number of swaps performed
+}
+
+sorted_disks sort_alternate(const disk_state& before, disk_backend backend = BACKEND_AUTO) {
+  return sort_alternate(before, ignore_swaps(), backend);
+}
+
+// Algorithm that sorts disks using the lawnmower algorithm, in place. visit
+// and stats work the same way as for sort_alternate_inplace.
+template <typename SwapVisitor, typename PassStats = no_pass_stats>
+uint64_t sort_lawnmower_inplace(disk_state& row, SwapVisitor&& visit,
+                                disk_backend backend = BACKEND_AUTO,
+                                PassStats&& stats = PassStats()) {
+  return packed_sort_lawnmower(row.word_data(), row.total_count(), backend, visit, stats);
+}
+
+uint64_t sort_lawnmower_inplace(disk_state& row, disk_backend backend = BACKEND_AUTO) {
+  return sort_lawnmower_inplace(row, ignore_swaps(), backend);
+}
+
+// Algorithm that sorts disks using the lawnmower algorithm, leaving before
+// untouched.
+template <typename SwapVisitor, typename PassStats = no_pass_stats>
+sorted_disks sort_lawnmower(const disk_state& before, SwapVisitor&& visit,
+                            disk_backend backend = BACKEND_AUTO,
+                            PassStats&& stats = PassStats()) {
+  disk_state after = before;            //make a copy of the disk
+  uint64_t count_swaps = sort_lawnmower_inplace(after, visit, backend, stats);
+  return sorted_disks(std::move(after), count_swaps);  //return the sorted disk with dark disks on the left side and light disks on the right side, including total number of swaps performed
+}
+
+sorted_disks sort_lawnmower(const disk_state& before, disk_backend backend = BACKEND_AUTO) {
+  return sort_lawnmower(before, ignore_swaps(), backend);
+}
 
-  while (a < n)                       //while total number of runs to be executed haven't been reached, continue
+// Index of the first light disk at or after index from. There must be one.
+size_t packed_find_light(const uint64_t* words, size_t from) {
+  size_t k = from / PACKED_WORD_BITS;
+  uint64_t w = words[k] & ~packed_prefix_mask(k, from);
+  while (w == 0) {
+    w = words[++k];
+  }
+  return k * PACKED_WORD_BITS + __builtin_ctzll(w);
+}
+
+// Index of the last dark disk before index before. There must be one.
+size_t packed_find_dark(const uint64_t* words, size_t before) {
+  size_t k = (before - 1) / PACKED_WORD_BITS;
+  uint64_t w = ~words[k] & packed_prefix_mask(k, before);
+  while (w == 0) {
+    w = ~words[--k];
+  }
+  return k * PACKED_WORD_BITS + 63 - __builtin_clzll(w);
+}
+
+// Lawnmower algorithm with each forward pass and the backward pass after it
+// fused into a single step, with exactly the same final row and swap count
+// as packed_sort_lawnmower.
+//
+// A forward pass takes the first light disk, at p, out of the row and puts
+// it on the right end, moving everything after it one place left: the dark
+// disks after p each make one swap. The backward pass then takes the last
+// dark disk, at q, out and puts it on the left end. Every disk before p is
+// dark and every disk after q is light, so the pair of passes leaves every
+// disk between p and q where it was, and just swaps the disks at p and q,
+// at a cost of q - p swaps. Once p is past q, every remaining pass swaps
+// nothing.
+//
+// p only moves right and q only moves left, so finding them costs one scan
+// of the row in total, and the whole sort runs in linear time rather than
+// streaming the row through the cache once per pass.
+uint64_t packed_sort_lawnmower_fused(uint64_t* words, size_t total) {
+  size_t rounds = sort_pass_count(total) / 2;   //one forward and one backward pass per round
+  size_t p = packed_find_light(words, 0);        //first light disk
+  size_t q = packed_find_dark(words, total);   //last dark disk
+  uint64_t count_swaps = 0;
+
+  for (size_t r = 0; r < rounds && p < q; ++r)
   {
-    for (size_t i = 0; i < after.total_count(); i += 2)    //run 1, alternate algorithm iterates over each pair, starting from the leftmost disk to the rightmost disk
+    count_swaps += q - p;
+    words[p / PACKED_WORD_BITS] ^= uint64_t(1) << (p % PACKED_WORD_BITS);
+    words[q / PACKED_WORD_BITS] ^= uint64_t(1) << (q % PACKED_WORD_BITS);
+    p = packed_find_light(words, p + 1);         //the disk now at q is light, so one exists
+    q = packed_find_dark(words, q);              //the disk now at p is dark, so one exists
+  }
+  return count_swaps;
+}
+
+// sort_lawnmower, with the same result, using packed_sort_lawnmower_fused.
+uint64_t sort_lawnmower_fused_inplace(disk_state& row) {
+  return packed_sort_lawnmower_fused(row.word_data(), row.total_count());
+}
+
+sorted_disks sort_lawnmower_fused(const disk_state& before) {
+  disk_state after = before;            //make a copy of the disk
+  uint64_t count_swaps = sort_lawnmower_fused_inplace(after);
+  return sorted_disks(std::move(after), count_swaps);
+}
+
+// Adaptive version of sort_alternate. Each pass only visits the window of
+// words that may still hold inversions, the window is shrunk after every
+// pass that swapped something, and the sort stops as soon as two passes in
+// a row are clean (which means the row is sorted). The skipped passes would
+// not have swapped anything, so the result and swap count are identical to
+// sort_alternate, but nearly sorted rows finish in close to linear time.
+sorted_disks sort_alternate_adaptive(const disk_state& before, disk_backend backend = BACKEND_AUTO) {
+  backend = resolve_backend(backend);
+  disk_state after = before;                      //make a copy of the disk
+  size_t n = (after.total_count() / 2);           //maximum number of runs to be executed
+  n += n % 2;                                     //sort_alternate always runs in pairs
+  size_t a = 0;                                   //stores number of runs
+  uint64_t count_swaps = 0;                       //stores count of swaps performed
+  int clean_runs = 0;                             //number of runs in a row without swaps
+  packed_window window = after.full_window();     //words that may still hold inversions
+
+  after.shrink_window(window);
+  while (a < n && clean_runs < 2 && !window.empty())
+  {
+    size_t run_swaps = after.alternate_pass(a % 2, window, backend);
+    if (run_swaps > 0)
     {
-      if (after.get(i) == DISK_LIGHT && after.get(i + 1) == DISK_DARK) //check if the left disk of the pair is light and right disk is dark
-      {
-        after.swap(i);                                                 //if true, swap them so that left disk is now dark and right disk is now light
-        count_swaps++;
-      }
+      count_swaps += run_swaps;
+      clean_runs = 0;
+      after.shrink_window(window);
     }
-    a++;
-    for (size_t i = 1; i < after.total_count() - 1; i += 2)  //run 2, alternate algorithm iterates over each pair, starting from the second leftmost disk to the second rightmost disk
+    else
     {
-      if (after.get(i) == DISK_LIGHT && after.get(i + 1) == DISK_DARK)  //check if the left disk of the pair is light and right disk is dark
-      {
-        after.swap(i);                                                  //if true, swap them so that left disk is now dark and right disk is now light
-        count_swaps++;
-      }
+      clean_runs++;
     }
     a++;
   }
 
-  return sorted_disks(after, count_swaps);  //return the sorted disk with dark disks on the left side and light disks on the right side, including total number of swaps performed
+  return sorted_disks(std::move(after), count_swaps);
 }
 
+// Adaptive version of sort_lawnmower, with the same window tracking as
+// sort_alternate_adaptive. A clean forward run means no dark disk has a
+// light disk before it, so the sort stops there.
+sorted_disks sort_lawnmower_adaptive(const disk_state& before, disk_backend backend = BACKEND_AUTO) {
+  backend = resolve_backend(backend);
+  disk_state after = before;                      //make a copy of the disk
+  size_t n = (after.total_count() / 2);           //maximum number of runs to be executed
+  size_t a = 0;                                   //stores number of runs
+  uint64_t count_swaps = 0;                       //stores count of swaps performed
+  packed_window window = after.full_window();     //words that may still hold inversions
 
-// Algorithm that sorts disks using the lawnmower algorithm.
-sorted_disks sort_lawnmower(const disk_state& before) {
-  disk_state after = before;            //make a copy of the disk
-  int n = (after.total_count() / 2);    //total number of runs to be executed
-  int a = 0;                            //stores number of runs
-  int count_swaps = 0;                  //stores count of swaps performed
-
-while (a < n)     //while total number of runs to be executed haven't been reached, continue
+  after.shrink_window(window);
+  while (a < n && !window.empty())
   {
-    for (size_t i = 0; i < after.total_count() - 1; i++)    //run 1 forward, starts with the leftmost disk to the right
+    size_t run_swaps = after.lawnmower_forward_pass(window, backend);
+    if (run_swaps == 0)
     {
-      if (after.get(i) == DISK_LIGHT && after.get(i + 1) == DISK_DARK)  //check if disk at index i is light and the disk after index i is dark
-      { 
-        after.swap(i);                                                  //if true, swap them so that left disk is now dark and right disk is now light
-        count_swaps++;
-      }
+      break;
     }
+    count_swaps += run_swaps;
+    after.shrink_window(window);
     a++;
-    for (size_t i = after.total_count() - 2; i > 0; i--)  //run 2 reverse, starts with the disk before the rightmost disk to the left until the disk before the leftmost end
-    {
-      if (after.get(i - 1) == DISK_LIGHT && after.get(i) == DISK_DARK)  //check if disk at index i is dark and the disk before index i is light
-      {
-        after.swap(i - 1);                                             //if true, swap them so that left disk is now dark and right disk is now light                             
+
+    count_swaps += after.lawnmower_backward_pass(window, backend);
+    after.shrink_window(window);
+    a++;
+  }
+
+  return sorted_disks(std::move(after), count_swaps);
+}
+
+// Barrier for a fixed group of threads. Passes are short, so waiting
+// threads spin (yielding their time slice) instead of sleeping on a
+// condition variable.
+class spin_barrier {
+private:
+  const unsigned _count;
+  std::atomic<unsigned> _waiting;
+  std::atomic<unsigned> _generation;
+
+public:
+  spin_barrier(unsigned count)
+    : _count(count), _waiting(0), _generation(0) {
+    assert(count > 0);
+  }
+
+  void wait() {
+    unsigned generation = _generation.load(std::memory_order_acquire);
+    if (_waiting.fetch_add(1, std::memory_order_acq_rel) + 1 == _count) {
+      _waiting.store(0, std::memory_order_relaxed);
+      _generation.fetch_add(1, std::memory_order_release);
+    } else {
+      while (_generation.load(std::memory_order_acquire) == generation) {
+        std::this_thread::yield();
+      }
+    }
+  }
+};
+
+// Fewest words each thread of sort_alternate_parallel is given when the
+// thread count is picked automatically.
+const size_t PARALLEL_MIN_WORDS_PER_THREAD = 512;
+
+// Multithreaded version of sort_alternate. Every pair compared in one run of
+// the alternate algorithm is independent, so each run is split across a
+// fixed group of threads, each owning a contiguous block of words, with a
+// barrier between runs. The pair that straddles two blocks in the second
+// run is swapped in a separate step after another barrier, so no two
+// threads ever write the same word at once. Each thread counts its own
+// swaps and the counts are added up at the end, so the result is identical
+// to sort_alternate.
+//
+// A thread_count of 0 picks one thread per core, but no more than one per
+// PARALLEL_MIN_WORDS_PER_THREAD words of the row.
+sorted_disks sort_alternate_parallel(const disk_state& before, unsigned thread_count = 0,
+                                     disk_backend backend = BACKEND_AUTO) {
+  backend = resolve_backend(backend);
+  size_t word_count = before.word_count();
+  if (thread_count == 0) {
+    thread_count = std::max(1u, std::thread::hardware_concurrency());
+    thread_count = std::min<size_t>(thread_count, word_count / PARALLEL_MIN_WORDS_PER_THREAD);
+  }
+  thread_count = std::min<size_t>(thread_count, word_count / 2);  //every block needs at least two words
+  if (thread_count <= 1) {
+    return sort_alternate(before, backend);
+  }
+
+  disk_state after = before;                      //make a copy of the disk
+  uint64_t* words = after.word_data();
+  size_t total = after.total_count();
+  size_t n = (after.total_count() / 2);           //total number of runs to be executed
+  std::vector<size_t> block_begin(thread_count + 1);
+  for (unsigned t = 0; t <= thread_count; ++t) {
+    block_begin[t] = word_count * t / thread_count;
+  }
+  std::vector<uint64_t> thread_swaps(thread_count, 0);
+  spin_barrier barrier(thread_count);
+
+  auto worker = [&](unsigned t) {
+    size_t lo = block_begin[t], hi = block_begin[t + 1];
+    size_t odd_pair_end = std::min(total - 1, hi * PACKED_WORD_BITS - 1);
+    uint64_t count_swaps = 0;
+
+    for (size_t a = 0; a < n; a += 2) {
+      count_swaps += packed_alternate_pairs(words, 0, lo, hi, total - 1, backend);     //run 1, never crosses a word
+      barrier.wait();
+      count_swaps += packed_alternate_pairs(words, 1, lo, hi, odd_pair_end, backend);  //run 2, inside the block
+      barrier.wait();
+      if (t > 0 && (words[lo - 1] >> 63) && !(words[lo] & 1)) {              //run 2, pair straddling the previous block
+        words[lo - 1] ^= uint64_t(1) << 63;
+        words[lo] ^= 1;
         count_swaps++;
       }
+      barrier.wait();
     }
-    a++;
+    thread_swaps[t] = count_swaps;
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned t = 1; t < thread_count; ++t) {
+    threads.push_back(std::thread(worker, t));
+  }
+  worker(0);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  uint64_t count_swaps = 0;
+  for (auto swaps : thread_swaps) {
+    count_swaps += swaps;
   }
-  return sorted_disks(after, count_swaps);  //return the sorted disk with dark disks on the left side and light disks on the right side, including total number of swaps performed
+  return sorted_disks(std::move(after), count_swaps);
+}
+
+// Algorithm that computes the outcome of sorting the disks to completion
+// without simulating any swaps. The final row is always the sorted one,
+// and the swap count is the number of (light, dark) inversions, which is
+// the number of swaps any adjacent-swap sort makes to sort the row fully.
+// Runs in a single linear scan of the row instead of O(n^2) time.
+//
+// This only matches sort_alternate and sort_lawnmower when their fixed
+// budget of passes sorts the row, as it always does for the alternating
+// rows built by disk_state(n). From other layouts, such as worst_case, the
+// budgeted sorters can stop short with fewer swaps, and the two disagree
+// with each other; sort_lawnmower_fused gives sort_lawnmower's exact
+// result in linear time.
+sorted_disks sort_counting(const disk_state& before) {
+  disk_state after = before;                      //make a copy of the disk
+  uint64_t count_swaps = after.inversion_count(); //one swap per inversion
+  after.set_sorted();                             //final state is known in advance
+  return sorted_disks(std::move(after), count_swaps);
 }
-  
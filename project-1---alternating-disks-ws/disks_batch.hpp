@@ -0,0 +1,165 @@
+///////////////////////////////////////////////////////////////////////////////
+// disks_batch.hpp
+//
+// Batch engine for sorting many independent rows of disks at once.
+//
+// Rows are kept back to back in one disk_batch arena instead of one
+// disk_state (and one heap allocation) each, and sort_batch sorts them in
+// place across a group of worker threads that steal rows from each other,
+// writing each row's swap count into a buffer supplied by the caller. Once
+// the batch is built, sorting it makes no per-row heap allocations.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "disks.hpp"
+
+// Many rows of disks in struct-of-arrays layout: the packed words of every
+// row in one contiguous vector, in the same layout as
+// disk_state::word_data(), plus the offset and length of each row.
+class disk_batch {
+private:
+  std::vector<uint64_t> _words;
+  std::vector<size_t> _first_word;                //row r is words [_first_word[r], _first_word[r + 1])
+  std::vector<size_t> _totals;
+
+public:
+  disk_batch()
+    : _first_word(1, 0) { }
+
+  // Reserve room for rows rows holding words packed words in total, so that
+  // adding them does not reallocate.
+  void reserve(size_t rows, size_t words) {
+    _words.reserve(words);
+    _first_word.reserve(rows + 1);
+    _totals.reserve(rows);
+  }
+
+  // Append a copy of row, and return its index in the batch.
+  size_t add(const disk_state& row) {
+    _words.insert(_words.end(), row.word_data(), row.word_data() + row.word_count());
+    _first_word.push_back(_words.size());
+    _totals.push_back(row.total_count());
+    return _totals.size() - 1;
+  }
+
+  size_t row_count() const {
+    return _totals.size();
+  }
+
+  size_t total_count(size_t row) const {
+    assert(row < row_count());
+    return _totals[row];
+  }
+
+  uint64_t* row_words(size_t row) {
+    assert(row < row_count());
+    return _words.data() + _first_word[row];
+  }
+
+  const uint64_t* row_words(size_t row) const {
+    assert(row < row_count());
+    return _words.data() + _first_word[row];
+  }
+
+  // Copy one row back out as a disk_state.
+  disk_state row(size_t row) const {
+    return disk_state::from_bitmap(row_words(row), total_count(row));
+  }
+};
+
+enum batch_algorithm { BATCH_ALTERNATE, BATCH_LAWNMOWER };
+
+// Range of rows [begin, end) waiting to be sorted by one worker. The owner
+// takes rows from the front; idle workers steal the back half.
+struct batch_queue {
+  std::mutex lock;
+  size_t begin, end;
+};
+
+// Take one row from queue, returning false when it is empty.
+bool batch_queue_pop(batch_queue& queue, size_t& row) {
+  std::lock_guard<std::mutex> guard(queue.lock);
+  if (queue.begin == queue.end) {
+    return false;
+  }
+  row = queue.begin++;
+  return true;
+}
+
+// Move the back half of some other worker's rows into queues[self],
+// returning false when every other queue is empty.
+bool batch_queue_steal(std::vector<batch_queue>& queues, size_t self) {
+  for (size_t i = 1; i < queues.size(); ++i) {
+    batch_queue& victim = queues[(self + i) % queues.size()];
+    size_t begin, end;
+    {
+      std::lock_guard<std::mutex> guard(victim.lock);
+      if (victim.begin == victim.end) {
+        continue;
+      }
+      end = victim.end;
+      begin = victim.begin + (victim.end - victim.begin) / 2;
+      victim.end = begin;
+    }
+    std::lock_guard<std::mutex> guard(queues[self].lock);
+    queues[self].begin = begin;
+    queues[self].end = end;
+    return true;
+  }
+  return false;
+}
+
+// Sort every row of batch in place with the chosen algorithm, and store the
+// number of swaps for row r in swap_counts[r], which must have room for
+// batch.row_count() entries. Results are identical to sorting each row with
+// sort_alternate or sort_lawnmower.
+//
+// Rows are dealt out to the workers in equal contiguous ranges, and a worker
+// that runs out steals half of another worker's remaining rows, so uneven
+// row sizes still balance. A thread_count of 0 uses one thread per core.
+void sort_batch(disk_batch& batch, batch_algorithm algorithm, uint64_t* swap_counts,
+                unsigned thread_count = 0, disk_backend backend = BACKEND_AUTO) {
+  backend = resolve_backend(backend);
+  size_t rows = batch.row_count();
+  if (thread_count == 0) {
+    thread_count = std::max(1u, std::thread::hardware_concurrency());
+  }
+  thread_count = std::max<size_t>(1, std::min<size_t>(thread_count, rows));
+
+  std::vector<batch_queue> queues(thread_count);
+  for (unsigned t = 0; t < thread_count; ++t) {
+    queues[t].begin = rows * t / thread_count;
+    queues[t].end = rows * (t + 1) / thread_count;
+  }
+
+  auto worker = [&](unsigned t) {
+    size_t row;
+    while (batch_queue_pop(queues[t], row) || (batch_queue_steal(queues, t)
+                                               && batch_queue_pop(queues[t], row))) {
+      if (algorithm == BATCH_ALTERNATE) {
+        swap_counts[row] = packed_sort_alternate(batch.row_words(row), batch.total_count(row), backend);
+      } else {
+        swap_counts[row] = packed_sort_lawnmower(batch.row_words(row), batch.total_count(row), backend);
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned t = 1; t < thread_count; ++t) {
+    threads.push_back(std::thread(worker, t));
+  }
+  worker(0);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
@@ -0,0 +1,260 @@
+///////////////////////////////////////////////////////////////////////////////
+// disks_bench.cpp
+//
+// Timing harness for the algorithms in disks.hpp. Times sort_alternate and
+// sort_lawnmower across a sweep of n, and writes the median time for each n
+// to alternate.csv and lawnmower.csv in the same n,seconds format as the
+// other projects' scatterplot data. The median and 95th percentile times are
+// also printed as the sweep runs.
+//
+// Usage: ./disks_bench [max_n] [layout]
+//        ./disks_bench verify [total]
+//        ./disks_bench passes [n] [layout]
+//
+// layout is the initial row to sort: alternating (the default), random,
+// worst or best; see the disk_state factory functions. Every timed run is
+// checked against a run on the scalar backend, and rows from the
+// alternating layout are also checked to come out sorted.
+//
+// The verify mode instead times is_initialized and is_sorted against the
+// element-by-element checks they replaced, run on a copy of the row in the
+// std::vector<disk_color> layout disk_state used before it was packed, on a
+// row of total disks (10^7 by default). Both rows pass their check, so
+// every disk is scanned.
+//
+// The passes mode sorts one row of n light disks (10^5 by default) with each
+// algorithm, recording every pass with pass_stats, and writes the records to
+// alternate_passes.csv and lawnmower_passes.csv for plotting convergence.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "disks.hpp"
+#include "disks_stats.hpp"
+#include "timer.hpp"
+
+using namespace std;
+
+// Summary of the repeated timings of one measurement, in seconds.
+struct bench_result {
+  double median;
+  double p95;
+};
+
+// Run sorter once untimed on the scalar backend, both to warm up caches and
+// the allocator and to get a reference result, then time repetitions runs
+// of it on the default backend. Every timed run must reproduce the
+// reference row and swap count. When must_sort is set, as it is for the
+// alternating row that both algorithms are specified for, the reference
+// must also be sorted; from other layouts, the fixed number of passes
+// need not finish the sort.
+bench_result time_sort(function<sorted_disks(const disk_state&, disk_backend)> sorter,
+                       const disk_state& before, int repetitions, bool must_sort) {
+  sorted_disks reference = sorter(before, BACKEND_SCALAR);
+  assert(!must_sort || reference.after().is_sorted());
+
+  vector<double> seconds;
+  for (int r = 0; r < repetitions; r++)
+  {
+    Timer timer;
+    auto output = sorter(before, BACKEND_AUTO);
+    seconds.push_back(timer.elapsed());
+    assert(output.after() == reference.after());
+    assert(output.swap_count() == reference.swap_count());
+  }
+
+  sort(seconds.begin(), seconds.end());
+  bench_result result;
+  result.median = seconds[seconds.size() / 2];
+  result.p95 = seconds[min(seconds.size() - 1, (seconds.size() * 95) / 100)];
+  return result;
+}
+
+// Build the initial row of n light disks for the given layout name.
+disk_state make_layout(const string& layout, size_t n) {
+  if (layout == "random") {
+    return disk_state::random(n, n);
+  } else if (layout == "worst") {
+    return disk_state::worst_case(n);
+  } else if (layout == "best") {
+    return disk_state::best_case(n);
+  }
+  return disk_state(n);
+}
+
+// The is_initialized and is_sorted that the packed checks replaced, on the
+// std::vector<disk_color> row disk_state used to store, as the baseline for
+// the verify mode.
+bool element_is_initialized(const vector<disk_color>& colors) {
+  for (size_t i = 0; i < colors.size(); ++i)
+  {
+    if (colors[i] != ((i % 2 == 0) ? DISK_LIGHT : DISK_DARK))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool element_is_sorted(const vector<disk_color>& colors) {
+  for (size_t i = 0; i < colors.size(); ++i)
+  {
+    if (colors[i] != ((i < colors.size() / 2) ? DISK_DARK : DISK_LIGHT))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Copy state into the one-disk_color-per-disk layout.
+vector<disk_color> element_colors(const disk_state& state) {
+  vector<disk_color> colors(state.total_count());
+  for (size_t i = 0; i < colors.size(); ++i)
+  {
+    colors[i] = state.get(i);
+  }
+  return colors;
+}
+
+// Median time of 21 runs of check on state, after one untimed run; check
+// must return true.
+template <typename Check, typename State>
+double time_check(Check check, const State& state) {
+  bool ok = check(state);
+  vector<double> seconds;
+  for (int r = 0; r < 21; r++)
+  {
+    Timer timer;
+    ok = check(state) && ok;
+    seconds.push_back(timer.elapsed());
+  }
+  if (!ok)
+  {
+    cerr << "check failed" << endl;
+    exit(1);
+  }
+  sort(seconds.begin(), seconds.end());
+  return seconds[seconds.size() / 2];
+}
+
+int verify_bench(size_t total)
+{
+  disk_state alternating(total / 2);
+  disk_state sorted(total / 2);
+  sorted.set_sorted();
+
+  double element_init = time_check(element_is_initialized, element_colors(alternating));
+  double word_init = time_check([](const disk_state& d) { return d.is_initialized(); }, alternating);
+  double element_sorted = time_check(element_is_sorted, element_colors(sorted));
+  double word_sorted = time_check([](const disk_state& d) { return d.is_sorted(); }, sorted);
+
+  cout << "verifying " << alternating.total_count() << " disks" << endl;
+  cout << scientific << setprecision(3);
+  cout << setw(16) << "check" << setw(16) << "vector<color>" << setw(16) << "packed word" << setw(12) << "speedup" << endl;
+  cout << setw(16) << "is_initialized" << setw(16) << element_init << setw(16) << word_init
+       << setw(12) << fixed << setprecision(1) << element_init / word_init << endl;
+  cout << scientific << setprecision(3);
+  cout << setw(16) << "is_sorted" << setw(16) << element_sorted << setw(16) << word_sorted
+       << setw(12) << fixed << setprecision(1) << element_sorted / word_sorted << endl;
+  return 0;
+}
+
+int passes_bench(size_t n, const string& layout)
+{
+  disk_state before = make_layout(layout, n);
+  pass_stats alternate, lawnmower;
+  sort_alternate(before, ignore_swaps(), BACKEND_AUTO, alternate);
+  sort_lawnmower(before, ignore_swaps(), BACKEND_AUTO, lawnmower);
+
+  ofstream alternate_csv("alternate_passes.csv");
+  alternate.write_csv(alternate_csv);
+  ofstream lawnmower_csv("lawnmower_passes.csv");
+  lawnmower.write_csv(lawnmower_csv);
+
+  cout << setw(12) << "algorithm" << setw(10) << "passes" << setw(10) << "no-ops"
+       << setw(16) << "compares" << setw(16) << "swaps" << setw(12) << "seconds" << endl;
+  cout << setw(12) << "alternate" << setw(10) << alternate.records().size() << setw(10) << alternate.noop_passes()
+       << setw(16) << alternate.total_compares() << setw(16) << alternate.total_swaps()
+       << setw(12) << alternate.total_seconds() << endl;
+  cout << setw(12) << "lawnmower" << setw(10) << lawnmower.records().size() << setw(10) << lawnmower.noop_passes()
+       << setw(16) << lawnmower.total_compares() << setw(16) << lawnmower.total_swaps()
+       << setw(12) << lawnmower.total_seconds() << endl;
+  return 0;
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc > 1 && string(argv[1]) == "verify")
+  {
+    return verify_bench((argc > 2) ? strtoul(argv[2], nullptr, 10) : 10000000);
+  }
+  if (argc > 1 && string(argv[1]) == "passes")
+  {
+    return passes_bench((argc > 2) ? strtoul(argv[2], nullptr, 10) : 100000,
+                        (argc > 3) ? argv[3] : "alternating");
+  }
+
+  size_t max_n = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 100000;
+  string layout = (argc > 2) ? argv[2] : "alternating";
+  if (layout != "alternating" && layout != "random" && layout != "worst" && layout != "best")
+  {
+    cerr << "unknown layout " << layout << endl;
+    return 1;
+  }
+
+  vector<size_t> sizes;
+  for (size_t decade = 10; decade <= max_n; decade *= 10)
+  {
+    for (size_t step : {1, 2, 5})
+    {
+      if (decade * step <= max_n)
+      {
+        sizes.push_back(decade * step);
+      }
+    }
+  }
+
+  ofstream alternate("alternate.csv");
+  alternate << "n,seconds" << endl;
+  alternate << fixed << setprecision(10);
+
+  ofstream lawnmower("lawnmower.csv");
+  lawnmower << "n,seconds" << endl;
+  lawnmower << fixed << setprecision(10);
+
+  cout << setw(10) << "n"
+       << setw(16) << "alternate p50" << setw(16) << "alternate p95"
+       << setw(16) << "lawnmower p50" << setw(16) << "lawnmower p95" << endl;
+  cout << scientific << setprecision(3);
+
+  for (size_t n : sizes)
+  {
+    disk_state before = make_layout(layout, n);
+    int repetitions = (n <= 10000) ? 21 : 5;   //large rows take a while per run
+
+    bool must_sort = (layout == "alternating");
+    auto alt = time_sort([](const disk_state& d, disk_backend backend) { return sort_alternate(d, backend); },
+                         before, repetitions, must_sort);
+    auto lawn = time_sort([](const disk_state& d, disk_backend backend) { return sort_lawnmower(d, backend); },
+                          before, repetitions, must_sort);
+
+    alternate << n << "," << alt.median << endl;
+    lawnmower << n << "," << lawn.median << endl;
+    cout << setw(10) << n
+         << setw(16) << alt.median << setw(16) << alt.p95
+         << setw(16) << lawn.median << setw(16) << lawn.p95 << endl;
+  }
+
+  alternate.close();
+  lawnmower.close();
+}
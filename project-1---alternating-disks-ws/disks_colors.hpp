@@ -0,0 +1,254 @@
+///////////////////////////////////////////////////////////////////////////////
+// disks_colors.hpp
+//
+// Generalization of the disks problem to rows of disks in up to 256 colors,
+// to be sorted by adjacent swaps into a chosen order of the colors.
+//
+// As with two colors, every adjacent swap of an out-of-order pair removes
+// exactly one inversion, so the number of swaps an adjacent-swap sort makes
+// is the number of pairs of disks whose colors are out of order.
+// sort_colors_counting finds that count with a Fenwick tree over the colors,
+// in O(n log k) time for n disks and k colors, instead of simulating up to
+// O(n^2) swaps as sort_colors_lawnmower does.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "disks.hpp"
+
+// Target order for sorting colored disks: the colors in the order they
+// should appear from left to right. Colors are small unsigned integers.
+template <typename Color = uint8_t>
+class color_order {
+private:
+  static_assert(std::is_unsigned<Color>::value, "disk colors must be unsigned integers");
+
+  std::vector<size_t> _rank;                      //_rank[c] is one more than the position of color c, or 0
+  size_t _count;
+
+public:
+  // Throws std::invalid_argument if a color appears more than once.
+  color_order(const std::vector<Color>& colors)
+    : _count(colors.size()) {
+
+    for (size_t i = 0; i < colors.size(); ++i) {
+      size_t c = colors[i];
+      if (c >= _rank.size()) {
+        _rank.resize(c + 1, 0);
+      }
+      if (_rank[c] != 0) {
+        throw std::invalid_argument("color_order lists a color more than once");
+      }
+      _rank[c] = i + 1;
+    }
+  }
+
+  // Number of colors in the order.
+  size_t color_count() const {
+    return _count;
+  }
+
+  bool contains(Color color) const {
+    return color < _rank.size() && _rank[color] != 0;
+  }
+
+  // Position of color in the order; color must be contained in it.
+  size_t rank(Color color) const {
+    assert(contains(color));
+    return _rank[color] - 1;
+  }
+};
+
+// A row of disks in any number of colors, one Color per disk. The two-color
+// disk_state corresponds to Color values DISK_DARK and DISK_LIGHT.
+template <typename Color = uint8_t>
+class colored_disk_state {
+private:
+  static_assert(std::is_unsigned<Color>::value, "disk colors must be unsigned integers");
+
+  std::vector<Color> _colors;
+
+public:
+  colored_disk_state(std::vector<Color> colors)
+    : _colors(std::move(colors)) { }
+
+  // total disks with colors drawn uniformly from [0, color_count), the same
+  // sequence for the same seed.
+  static colored_disk_state random(size_t total, size_t color_count, uint64_t seed) {
+    assert(color_count > 0 && color_count - 1 <= std::numeric_limits<Color>::max());
+    std::mt19937_64 rng(seed);
+    std::vector<Color> colors(total);
+    for (auto& c : colors) {
+      c = static_cast<Color>(rng() % color_count);
+    }
+    return colored_disk_state(std::move(colors));
+  }
+
+  // Copy a two-color row, with DISK_DARK and DISK_LIGHT as the colors.
+  static colored_disk_state from_disks(const disk_state& row) {
+    std::vector<Color> colors(row.total_count());
+    for (size_t i = 0; i < colors.size(); ++i) {
+      colors[i] = static_cast<Color>(row.get(i));
+    }
+    return colored_disk_state(std::move(colors));
+  }
+
+  bool operator== (const colored_disk_state& rhs) const {
+    return _colors == rhs._colors;
+  }
+
+  size_t total_count() const {
+    return _colors.size();
+  }
+
+  bool is_index(size_t i) const {
+    return (i < total_count());
+  }
+
+  Color get(size_t index) const {
+    assert(is_index(index));
+    return _colors[index];
+  }
+
+  void swap(size_t left_index) {
+    assert(is_index(left_index));
+    auto right_index = left_index + 1;
+    assert(is_index(right_index));
+    std::swap(_colors[left_index], _colors[right_index]);
+  }
+
+  const std::vector<Color>& colors() const {
+    return _colors;
+  }
+
+  // Throws std::invalid_argument unless every disk's color is in order.
+  void check_colors(const color_order<Color>& order) const {
+    for (Color c : _colors) {
+      if (!order.contains(c)) {
+        throw std::invalid_argument("disk color missing from color_order");
+      }
+    }
+  }
+
+  // Return true when every disk's color comes no later in order than the
+  // color of the disk to its right.
+  bool is_sorted(const color_order<Color>& order) const {
+    for (size_t i = 0; i + 1 < total_count(); ++i) {
+      if (order.rank(_colors[i]) > order.rank(_colors[i + 1])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Number of pairs of disks whose colors are out of order, which is the
+  // number of adjacent swaps needed to sort the row. Scans left to right,
+  // keeping a Fenwick tree of how many disks of each rank have been seen.
+  uint64_t inversion_count(const color_order<Color>& order) const {
+    check_colors(order);
+    size_t k = order.color_count();
+    std::vector<uint64_t> tree(k + 1, 0);         //tree[r] covers ranks (r - (r & -r), r], 1-based
+    uint64_t inversions = 0;
+
+    for (size_t i = 0; i < total_count(); ++i) {
+      size_t r = order.rank(_colors[i]) + 1;
+      uint64_t not_after = 0;                     //disks seen so far ranked no later than this one
+      for (size_t j = r; j > 0; j -= j & (~j + 1)) {
+        not_after += tree[j];
+      }
+      inversions += i - not_after;
+      for (size_t j = r; j <= k; j += j & (~j + 1)) {
+        tree[j]++;
+      }
+    }
+    return inversions;
+  }
+};
+
+// Output of the colored disk sorting algorithms, as sorted_disks is for two
+// colors.
+template <typename Color = uint8_t>
+class sorted_colored_disks {
+private:
+  colored_disk_state<Color> _after;
+  uint64_t _swap_count;
+
+public:
+  sorted_colored_disks(colored_disk_state<Color>&& after, uint64_t swap_count)
+    : _after(std::move(after)), _swap_count(swap_count) { }
+
+  const colored_disk_state<Color>& after() const {
+    return _after;
+  }
+
+  uint64_t swap_count() const {
+    return _swap_count;
+  }
+};
+
+// Sort before into order, reporting the exact number of swaps any
+// adjacent-swap sort would make, without simulating them. The sorted row is
+// built by counting the disks of each color, so the whole algorithm runs in
+// O(n log k) time. Throws std::invalid_argument if a disk's color is not in
+// order.
+template <typename Color>
+sorted_colored_disks<Color> sort_colors_counting(const colored_disk_state<Color>& before,
+                                                 const color_order<Color>& order) {
+  uint64_t count_swaps = before.inversion_count(order);
+
+  std::vector<size_t> per_rank(order.color_count(), 0);
+  std::vector<Color> by_rank(order.color_count());
+  for (Color c : before.colors()) {
+    per_rank[order.rank(c)]++;
+    by_rank[order.rank(c)] = c;
+  }
+  std::vector<Color> colors;
+  colors.reserve(before.total_count());
+  for (size_t r = 0; r < per_rank.size(); ++r) {
+    colors.insert(colors.end(), per_rank[r], by_rank[r]);
+  }
+  return sorted_colored_disks<Color>(colored_disk_state<Color>(std::move(colors)), count_swaps);
+}
+
+// Sort before into order by simulating the lawnmower algorithm: forward and
+// backward passes of adjacent swaps, until a pass makes no swaps. Takes
+// O(n^2) time; sort_colors_counting gives the same result far faster.
+template <typename Color>
+sorted_colored_disks<Color> sort_colors_lawnmower(const colored_disk_state<Color>& before,
+                                                  const color_order<Color>& order) {
+  before.check_colors(order);
+  colored_disk_state<Color> after = before;
+  size_t n = after.total_count();
+  uint64_t count_swaps = 0;
+
+  bool swapped = (n > 1);
+  while (swapped) {
+    swapped = false;
+    for (size_t i = 0; i + 1 < n; ++i) {          //forward pass, leftmost pair to the right
+      if (order.rank(after.get(i)) > order.rank(after.get(i + 1))) {
+        after.swap(i);
+        count_swaps++;
+        swapped = true;
+      }
+    }
+    for (size_t i = n - 1; i > 0; --i) {          //backward pass, rightmost pair to the left
+      if (order.rank(after.get(i - 1)) > order.rank(after.get(i))) {
+        after.swap(i - 1);
+        count_swaps++;
+        swapped = true;
+      }
+    }
+  }
+  return sorted_colored_disks<Color>(std::move(after), count_swaps);
+}
@@ -0,0 +1,197 @@
+///////////////////////////////////////////////////////////////////////////////
+// disks_fixed.hpp
+//
+// sort_alternate and sort_lawnmower specialized at compile time for a fixed
+// number of light disks, N, from 1 to 64.
+//
+// The whole row is held in one integer, a uint64_t for N <= 32 and an
+// unsigned __int128 above that, in the same layout as disk_state's packed
+// words: disk i is bit i, set for a light disk. Every pass is a handful of
+// bit operations on that integer, and the passes are unrolled by template
+// recursion, so a sort is straight-line code. Everything is constexpr, so a
+// sort can also be evaluated by the compiler, for example in a
+// static_assert:
+//
+//   static_assert(fixed_sort_alternate<3>(fixed_alternating<3>()).swap_count == 6, "");
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "disks.hpp"
+
+// Integer type holding a row of N light and N dark disks.
+template <size_t N>
+using fixed_word = typename std::conditional<(2 * N <= 64), uint64_t, unsigned __int128>::type;
+
+// A row and the number of swaps performed to reach it.
+template <typename Word>
+struct fixed_sorted {
+  Word after;
+  uint64_t swap_count;
+};
+
+constexpr unsigned fixed_popcount(uint64_t w) {
+  return __builtin_popcountll(w);
+}
+
+constexpr unsigned fixed_popcount(unsigned __int128 w) {
+  return __builtin_popcountll(uint64_t(w)) + __builtin_popcountll(uint64_t(w >> 64));
+}
+
+// Index of the lowest set bit of w, which must not be zero.
+constexpr size_t fixed_lowest_bit(uint64_t w) {
+  return __builtin_ctzll(w);
+}
+
+constexpr size_t fixed_lowest_bit(unsigned __int128 w) {
+  return uint64_t(w) ? __builtin_ctzll(uint64_t(w)) : 64 + __builtin_ctzll(uint64_t(w >> 64));
+}
+
+// Index of the highest set bit of w, which must not be zero.
+constexpr size_t fixed_highest_bit(uint64_t w) {
+  return 63 - __builtin_clzll(w);
+}
+
+constexpr size_t fixed_highest_bit(unsigned __int128 w) {
+  return uint64_t(w >> 64) ? 127 - __builtin_clzll(uint64_t(w >> 64)) : 63 - __builtin_clzll(uint64_t(w));
+}
+
+// PACKED_EVEN_BITS repeated across a whole Word; the argument only selects
+// the type.
+constexpr uint64_t fixed_even_bits(uint64_t) {
+  return PACKED_EVEN_BITS;
+}
+
+constexpr unsigned __int128 fixed_even_bits(unsigned __int128) {
+  return (static_cast<unsigned __int128>(PACKED_EVEN_BITS) << 64) | PACKED_EVEN_BITS;
+}
+
+// Mask of bits [0, k).
+template <typename Word>
+constexpr Word fixed_low_bits(size_t k) {
+  return (k >= 8 * sizeof(Word)) ? ~Word(0) : (Word(1) << k) - 1;
+}
+
+// One pass of the alternate algorithm over a row of total disks: swap every
+// (light, dark) pair (i, i + 1) with i of the same parity as first.
+template <typename Word>
+constexpr fixed_sorted<Word> fixed_alternate_moves(fixed_sorted<Word> s, Word lefts) {
+  return { s.after ^ (lefts | (lefts << 1)), s.swap_count + fixed_popcount(lefts) };
+}
+
+template <typename Word>
+constexpr fixed_sorted<Word> fixed_alternate_pass(fixed_sorted<Word> s, size_t total, size_t first) {
+  return fixed_alternate_moves(s, s.after & ~(s.after >> 1) & fixed_low_bits<Word>(total - 1)
+                                  & (first ? (fixed_even_bits(Word()) << 1) : fixed_even_bits(Word())));
+}
+
+// Forward lawnmower pass: every dark disk to the right of the first light
+// disk moves one place left. moving is the mask of those dark disks.
+template <typename Word>
+constexpr fixed_sorted<Word> fixed_forward_moves(fixed_sorted<Word> s, Word valid, Word moving) {
+  return { valid & ~((~s.after & valid & ~moving) | (moving >> 1)), s.swap_count + fixed_popcount(moving) };
+}
+
+template <typename Word>
+constexpr fixed_sorted<Word> fixed_forward_pass(fixed_sorted<Word> s, size_t total) {
+  return fixed_forward_moves(s, fixed_low_bits<Word>(total),
+                             ~s.after & fixed_low_bits<Word>(total)
+                             & ~fixed_low_bits<Word>(fixed_lowest_bit(s.after) + 1));
+}
+
+// Backward lawnmower pass, which stops at the disk before the rightmost:
+// every light disk to the left of the last dark disk in that range moves
+// one place right. below is the mask of positions left of that dark disk.
+template <typename Word>
+constexpr fixed_sorted<Word> fixed_backward_moves(fixed_sorted<Word> s, Word below) {
+  return { (s.after & ~((below << 1) | 1)) | ((s.after & below) << 1),
+           s.swap_count + fixed_popcount(s.after & below) };
+}
+
+template <typename Word>
+constexpr fixed_sorted<Word> fixed_backward_pass(fixed_sorted<Word> s, size_t total) {
+  return (~s.after & fixed_low_bits<Word>(total - 1))
+         ? fixed_backward_moves(s, fixed_low_bits<Word>(fixed_highest_bit(~s.after & fixed_low_bits<Word>(total - 1))))
+         : s;
+}
+
+// Passes [Pass, N + N % 2) of either algorithm on a row of N light disks,
+// one template instance per pass so that the recursion unrolls completely.
+template <size_t N, size_t Pass = 0, bool Done = (Pass >= N + N % 2)>
+struct fixed_passes {
+  typedef fixed_sorted<fixed_word<N>> state;
+
+  static constexpr state alternate(state s) {
+    return fixed_passes<N, Pass + 1>::alternate(fixed_alternate_pass(s, 2 * N, Pass % 2));
+  }
+
+  static constexpr state lawnmower(state s) {
+    return fixed_passes<N, Pass + 1>::lawnmower((Pass % 2 == 0) ? fixed_forward_pass(s, 2 * N)
+                                                                : fixed_backward_pass(s, 2 * N));
+  }
+};
+
+template <size_t N, size_t Pass>
+struct fixed_passes<N, Pass, true> {
+  typedef fixed_sorted<fixed_word<N>> state;
+
+  static constexpr state alternate(state s) {
+    return s;
+  }
+
+  static constexpr state lawnmower(state s) {
+    return s;
+  }
+};
+
+// The alternating row of N light disks, as disk_state(N) starts.
+template <size_t N>
+constexpr fixed_word<N> fixed_alternating() {
+  static_assert(N >= 1 && N <= 64, "fixed sorters handle 1 to 64 light disks");
+  return fixed_even_bits(fixed_word<N>()) & fixed_low_bits<fixed_word<N>>(2 * N);
+}
+
+// Whether row is all N dark disks followed by all N light disks.
+template <size_t N>
+constexpr bool fixed_is_sorted(fixed_word<N> row) {
+  return row == (fixed_low_bits<fixed_word<N>>(2 * N) & ~fixed_low_bits<fixed_word<N>>(N));
+}
+
+// The same sort, and swap count, as sort_alternate on a row of N light
+// disks.
+template <size_t N>
+constexpr fixed_sorted<fixed_word<N>> fixed_sort_alternate(fixed_word<N> before) {
+  static_assert(N >= 1 && N <= 64, "fixed sorters handle 1 to 64 light disks");
+  return fixed_passes<N>::alternate({ before, 0 });
+}
+
+// The same sort, and swap count, as sort_lawnmower on a row of N light
+// disks.
+template <size_t N>
+constexpr fixed_sorted<fixed_word<N>> fixed_sort_lawnmower(fixed_word<N> before) {
+  static_assert(N >= 1 && N <= 64, "fixed sorters handle 1 to 64 light disks");
+  return fixed_passes<N>::lawnmower({ before, 0 });
+}
+
+// Convert between disk_state and the fixed row of N light disks.
+template <size_t N>
+fixed_word<N> fixed_from_disks(const disk_state& row) {
+  assert(row.total_count() == 2 * N);
+  fixed_word<N> word = 0;
+  for (size_t k = 0; k < row.word_count(); ++k) {
+    word |= fixed_word<N>(row.word_data()[k]) << (k * PACKED_WORD_BITS);
+  }
+  return word;
+}
+
+template <size_t N>
+disk_state fixed_to_disks(fixed_word<N> word) {
+  uint64_t bitmap[2] = { uint64_t(word), uint64_t(static_cast<unsigned __int128>(word) >> 64) };
+  return disk_state::from_bitmap(bitmap, 2 * N);
+}
@@ -0,0 +1,263 @@
+///////////////////////////////////////////////////////////////////////////////
+// disks_io.hpp
+//
+// Saving rows of disks to files and loading them back, for checkpointing
+// huge rows and long-running sorts.
+//
+// Text files hold the same format as disk_state::to_string(). Saving streams
+// the text out in chunks, and loading maps the file into memory and parses it
+// in place, so neither side ever holds a second copy of the row as text.
+//
+// Snapshot files hold a sort in progress in a compact binary format, so a
+// sort killed part way through can resume from its last checkpoint instead
+// of starting over; see sort_resumable.
+//
+// Errors opening, mapping or writing a file throw std::runtime_error; a file
+// that is not a valid row throws std::invalid_argument, as from_string does.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "disks.hpp"
+
+// Read-only memory mapping of a whole file, unmapped when destroyed.
+class mapped_file {
+private:
+  const char* _data;
+  size_t _size;
+
+  mapped_file(const mapped_file&) = delete;
+  mapped_file& operator=(const mapped_file&) = delete;
+
+  static std::runtime_error error(const std::string& what, const std::string& path) {
+    return std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+  }
+
+public:
+  mapped_file(const std::string& path)
+    : _data(nullptr), _size(0) {
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw error("cannot open", path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+      close(fd);
+      throw error("cannot stat", path);
+    }
+    _size = info.st_size;
+    if (_size > 0) {
+      void* data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED) {
+        close(fd);
+        throw error("cannot map", path);
+      }
+      madvise(data, _size, MADV_SEQUENTIAL);
+      _data = static_cast<const char*>(data);
+    }
+    close(fd);
+  }
+
+  ~mapped_file() {
+    if (_data) {
+      munmap(const_cast<char*>(_data), _size);
+    }
+  }
+
+  const char* data() const {
+    return _data;
+  }
+
+  size_t size() const {
+    return _size;
+  }
+};
+
+// Write row to path as text, replacing any existing file.
+void save_disks_text(const disk_state& row, const std::string& path) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    throw std::runtime_error("cannot create " + path);
+  }
+  row.write_text(out);
+  out.close();
+  if (!out) {
+    throw std::runtime_error("cannot write " + path);
+  }
+}
+
+// Load a row saved by save_disks_text, parsing it straight out of a memory
+// mapping of the file.
+disk_state load_disks_text(const std::string& path) {
+  mapped_file file(path);
+  return disk_state::from_text(file.data(), file.size());
+}
+
+// Which sort a snapshot belongs to.
+enum snapshot_algorithm { SNAPSHOT_ALTERNATE, SNAPSHOT_LAWNMOWER };
+
+// A sort_alternate or sort_lawnmower run in progress: the row once the
+// first `pass` passes of the algorithm have run, and the swaps they made.
+struct disk_snapshot {
+  disk_state row;
+  snapshot_algorithm algorithm;
+  uint64_t pass;
+  uint64_t swap_count;
+};
+
+// Snapshot files are a 48-byte header followed by the row's packed words, as
+// in disk_state::word_data(). Every field is in the machine's byte order.
+//
+//   offset  0  char[8]   "DISKSNAP"
+//   offset  8  uint32_t  format version, currently 1
+//   offset 12  uint32_t  snapshot_algorithm
+//   offset 16  uint64_t  total disks
+//   offset 24  uint64_t  passes already run
+//   offset 32  uint64_t  swaps performed by those passes
+//   offset 40  uint64_t  number of packed words that follow
+const char SNAPSHOT_MAGIC[8] = { 'D', 'I', 'S', 'K', 'S', 'N', 'A', 'P' };
+const uint32_t SNAPSHOT_VERSION = 1;
+
+struct snapshot_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t algorithm;
+  uint64_t total;
+  uint64_t pass;
+  uint64_t swap_count;
+  uint64_t word_count;
+};
+
+static_assert(sizeof(snapshot_header) == 48, "snapshot_header must have no padding");
+
+// Write snapshot to path. The file is written under a temporary name and
+// then renamed over path, so a job killed while saving leaves the previous
+// snapshot intact.
+void save_disks_snapshot(const disk_snapshot& snapshot, const std::string& path) {
+  snapshot_header header;
+  std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.version = SNAPSHOT_VERSION;
+  header.algorithm = snapshot.algorithm;
+  header.total = snapshot.row.total_count();
+  header.pass = snapshot.pass;
+  header.swap_count = snapshot.swap_count;
+  header.word_count = snapshot.row.word_count();
+
+  std::string temporary = path + ".tmp";
+  {
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      throw std::runtime_error("cannot create " + temporary);
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(snapshot.row.word_data()),
+              snapshot.row.word_count() * sizeof(uint64_t));
+    out.close();
+    if (!out) {
+      throw std::runtime_error("cannot write " + temporary);
+    }
+  }
+  if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+    throw std::runtime_error("cannot rename " + temporary + " to " + path + ": " + std::strerror(errno));
+  }
+}
+
+// Load a snapshot saved by save_disks_snapshot, copying the row straight
+// out of a memory mapping of the file. Throws std::invalid_argument when the
+// file is not a valid snapshot.
+disk_snapshot load_disks_snapshot(const std::string& path) {
+  mapped_file file(path);
+  snapshot_header header;
+  if (file.size() < sizeof(header)) {
+    throw std::invalid_argument(path + " is too short to be a disk snapshot");
+  }
+  std::memcpy(&header, file.data(), sizeof(header));
+  if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) {
+    throw std::invalid_argument(path + " is not a disk snapshot");
+  }
+  if (header.version != SNAPSHOT_VERSION) {
+    throw std::invalid_argument(path + " has unsupported snapshot version " + std::to_string(header.version));
+  }
+  if (header.algorithm != SNAPSHOT_ALTERNATE && header.algorithm != SNAPSHOT_LAWNMOWER) {
+    throw std::invalid_argument(path + " has an unknown sorting algorithm");
+  }
+  if (header.word_count != packed_word_count(header.total)
+      || file.size() != sizeof(header) + header.word_count * sizeof(uint64_t)
+      || header.pass > sort_pass_count(header.total)) {
+    throw std::invalid_argument(path + " is a corrupt disk snapshot");
+  }
+
+  const uint64_t* words = reinterpret_cast<const uint64_t*>(file.data() + sizeof(header));
+  return disk_snapshot { disk_state::from_bitmap(words, header.total),
+                         snapshot_algorithm(header.algorithm), header.pass, header.swap_count };
+}
+
+// Run the passes of snapshot's sort from snapshot.pass up to end_pass, or
+// to the end of the sort if that comes first, updating snapshot in place.
+void advance_snapshot(disk_snapshot& snapshot, uint64_t end_pass,
+                      disk_backend backend = BACKEND_AUTO) {
+  end_pass = std::min<uint64_t>(end_pass, sort_pass_count(snapshot.row.total_count()));
+  if (snapshot.pass >= end_pass) {
+    return;
+  }
+  if (snapshot.algorithm == SNAPSHOT_ALTERNATE) {
+    snapshot.swap_count += packed_alternate_passes(snapshot.row.word_data(), snapshot.row.total_count(),
+                                                   snapshot.pass, end_pass, backend);
+  } else {
+    snapshot.swap_count += packed_lawnmower_passes(snapshot.row.word_data(), snapshot.row.total_count(),
+                                                   snapshot.pass, end_pass, backend);
+  }
+  snapshot.pass = end_pass;
+}
+
+// Sort before with the given algorithm, with exactly the same result as
+// sort_alternate or sort_lawnmower, saving a snapshot to checkpoint_path
+// after every checkpoint_passes passes. When checkpoint_path already holds
+// a snapshot from an earlier, interrupted, call, the sort resumes from it
+// rather than from before. The snapshot is removed once the sort finishes.
+//
+// Throws std::invalid_argument if checkpoint_passes is zero, or the
+// existing snapshot is for a different algorithm or row length.
+sorted_disks sort_resumable(const disk_state& before, snapshot_algorithm algorithm,
+                            const std::string& checkpoint_path, uint64_t checkpoint_passes,
+                            disk_backend backend = BACKEND_AUTO) {
+  if (checkpoint_passes == 0) {
+    throw std::invalid_argument("checkpoint_passes must be positive");
+  }
+
+  struct stat info;
+  bool resuming = (stat(checkpoint_path.c_str(), &info) == 0);
+  disk_snapshot snapshot = resuming ? load_disks_snapshot(checkpoint_path)
+                                    : disk_snapshot { before, algorithm, 0, 0 };
+  if (snapshot.algorithm != algorithm || snapshot.row.total_count() != before.total_count()) {
+    throw std::invalid_argument(checkpoint_path + " is a snapshot of a different sort");
+  }
+
+  uint64_t pass_count = sort_pass_count(before.total_count());
+  while (snapshot.pass < pass_count) {
+    advance_snapshot(snapshot, snapshot.pass + std::min(checkpoint_passes, pass_count - snapshot.pass), backend);
+    if (snapshot.pass < pass_count) {
+      save_disks_snapshot(snapshot, checkpoint_path);
+    }
+  }
+  std::remove(checkpoint_path.c_str());
+  return sorted_disks(std::move(snapshot.row), snapshot.swap_count);
+}
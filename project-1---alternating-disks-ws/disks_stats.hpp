@@ -0,0 +1,120 @@
+///////////////////////////////////////////////////////////////////////////////
+// disks_stats.hpp
+//
+// Per-pass statistics for sort_alternate and sort_lawnmower.
+//
+// Pass a pass_stats object as the stats argument of a sorter to record, for
+// every pass, how many adjacent pairs it compared, how many it swapped, and
+// how long it took, measured with Timer. The records can be written out as
+// CSV or JSON to plot how the sort converges. Sorters given no stats object
+// use no_pass_stats, and the recording compiles away.
+//
+//   pass_stats stats;
+//   sort_lawnmower(before, ignore_swaps(), BACKEND_AUTO, stats);
+//   std::ofstream csv("passes.csv");
+//   stats.write_csv(csv);
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "disks.hpp"
+#include "timer.hpp"
+
+// Counters for one pass of a sort.
+struct pass_record {
+  size_t pass;
+  uint64_t compares;
+  uint64_t swaps;
+  double seconds;
+};
+
+class pass_stats {
+private:
+  std::vector<pass_record> _records;
+  Timer _timer;
+
+public:
+  void begin_pass(size_t) {
+    _timer.reset();
+  }
+
+  void end_pass(size_t pass, uint64_t compares, uint64_t swaps) {
+    double seconds = _timer.elapsed();
+    _records.push_back(pass_record { pass, compares, swaps, seconds });
+  }
+
+  // Forget every pass recorded so far, to reuse this object for another
+  // sort.
+  void clear() {
+    _records.clear();
+  }
+
+  const std::vector<pass_record>& records() const {
+    return _records;
+  }
+
+  uint64_t total_compares() const {
+    uint64_t compares = 0;
+    for (auto& r : _records) {
+      compares += r.compares;
+    }
+    return compares;
+  }
+
+  uint64_t total_swaps() const {
+    uint64_t swaps = 0;
+    for (auto& r : _records) {
+      swaps += r.swaps;
+    }
+    return swaps;
+  }
+
+  // Number of passes that swapped nothing.
+  size_t noop_passes() const {
+    size_t noops = 0;
+    for (auto& r : _records) {
+      noops += (r.swaps == 0);
+    }
+    return noops;
+  }
+
+  double total_seconds() const {
+    double seconds = 0;
+    for (auto& r : _records) {
+      seconds += r.seconds;
+    }
+    return seconds;
+  }
+
+  // One line per pass, under the header pass,compares,swaps,seconds.
+  void write_csv(std::ostream& out) const {
+    out << "pass,compares,swaps,seconds\n";
+    for (auto& r : _records) {
+      out << r.pass << ',' << r.compares << ',' << r.swaps << ',' << r.seconds << '\n';
+    }
+  }
+
+  // An object holding the totals and an array of per-pass objects with the
+  // same fields as the CSV.
+  void write_json(std::ostream& out) const {
+    out << "{\"passes\":" << _records.size()
+        << ",\"noop_passes\":" << noop_passes()
+        << ",\"compares\":" << total_compares()
+        << ",\"swaps\":" << total_swaps()
+        << ",\"seconds\":" << total_seconds()
+        << ",\"records\":[";
+    for (size_t i = 0; i < _records.size(); ++i) {
+      const pass_record& r = _records[i];
+      out << (i ? "," : "")
+          << "{\"pass\":" << r.pass << ",\"compares\":" << r.compares
+          << ",\"swaps\":" << r.swaps << ",\"seconds\":" << r.seconds << '}';
+    }
+    out << "]}\n";
+  }
+};
@@ -5,9 +5,147 @@
 //
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <vector>
 #include "rubrictest.hpp"
 #include "disks.hpp"
+#include "disks_batch.hpp"
+#include "disks_colors.hpp"
+#include "disks_fixed.hpp"
+#include "disks_io.hpp"
+#include "disks_stats.hpp"
+
+// Allocation tracking, so tests can check how much memory the sorters use.
+// Every block is prefixed with its size so operator delete can account for
+// it. The header is found again through the address as an integer: at -O2
+// GCC sees `pointer - ALLOCATION_HEADER` step before whatever object it
+// thinks pointer came from and warns with -Warray-bounds.
+const size_t ALLOCATION_HEADER = 16;
+std::atomic<size_t> live_bytes(0), peak_bytes(0);
+
+void* operator new(size_t size) {
+  void* block = std::malloc(size + ALLOCATION_HEADER);
+  if (!block) {
+    throw std::bad_alloc();
+  }
+  *static_cast<size_t*>(block) = size;
+  size_t live = (live_bytes += size);
+  size_t peak = peak_bytes.load();
+  while (live > peak && !peak_bytes.compare_exchange_weak(peak, live)) { }
+  return static_cast<char*>(block) + ALLOCATION_HEADER;
+}
+
+void operator delete(void* pointer) noexcept {
+  if (pointer) {
+    void* block = reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(pointer) - ALLOCATION_HEADER);
+    live_bytes -= *static_cast<size_t*>(block);
+    std::free(block);
+  }
+}
+
+// Reference element-by-element passes, used to check the bit-packed passes
+// in disk_state.
+size_t reference_alternate_pass(disk_state& state, size_t first,
+                                std::vector<size_t>* log = nullptr) {
+  size_t swaps = 0;
+  for (size_t i = first; i + 1 < state.total_count(); i += 2) {
+    if (state.get(i) == DISK_LIGHT && state.get(i + 1) == DISK_DARK) {
+      state.swap(i);
+      swaps++;
+      if (log) log->push_back(i);
+    }
+  }
+  return swaps;
+}
+
+size_t reference_forward_pass(disk_state& state, std::vector<size_t>* log = nullptr) {
+  size_t swaps = 0;
+  for (size_t i = 0; i + 1 < state.total_count(); i++) {
+    if (state.get(i) == DISK_LIGHT && state.get(i + 1) == DISK_DARK) {
+      state.swap(i);
+      swaps++;
+      if (log) log->push_back(i);
+    }
+  }
+  return swaps;
+}
+
+size_t reference_backward_pass(disk_state& state, std::vector<size_t>* log = nullptr) {
+  size_t swaps = 0;
+  for (size_t i = state.total_count() - 2; i > 0; i--) {
+    if (state.get(i - 1) == DISK_LIGHT && state.get(i) == DISK_DARK) {
+      state.swap(i - 1);
+      swaps++;
+      if (log) log->push_back(i - 1);
+    }
+  }
+  return swaps;
+}
+
+// Reference element-by-element checks, used to check the word-wise
+// is_initialized and is_sorted.
+bool reference_is_initialized(const disk_state& state) {
+  for (size_t i = 0; i < state.total_count(); i++) {
+    if (state.get(i) != ((i % 2 == 0) ? DISK_LIGHT : DISK_DARK)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool reference_is_sorted(const disk_state& state) {
+  for (size_t i = 0; i < state.total_count(); i++) {
+    if (state.get(i) != ((i < state.total_count() / 2) ? DISK_DARK : DISK_LIGHT)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Shuffle a row in place with a fixed sequence of adjacent swaps.
+void scramble(disk_state& state, unsigned seed) {
+  for (size_t k = 0; k < 4 * state.total_count(); ++k) {
+    seed = seed * 1103515245U + 12345U;
+    state.swap((seed >> 8) % (state.total_count() - 1));
+  }
+}
+
+// The fixed sorters evaluate at compile time.
+static_assert(fixed_sort_alternate<3>(fixed_alternating<3>()).swap_count == 6, "fixed alternate, n=3");
+static_assert(fixed_is_sorted<3>(fixed_sort_alternate<3>(fixed_alternating<3>()).after), "fixed alternate sorts");
+static_assert(fixed_sort_lawnmower<4>(fixed_alternating<4>()).swap_count == 10, "fixed lawnmower, n=4");
+static_assert(fixed_is_sorted<64>(fixed_sort_lawnmower<64>(fixed_alternating<64>()).after), "fixed lawnmower sorts");
+
+// Check the fixed sorters for N light disks against sort_alternate and
+// sort_lawnmower, on the alternating row and a few random ones.
+template <size_t N>
+void check_fixed_sorters() {
+  TEST_EQUAL("fixed_alternating()", disk_state(N), fixed_to_disks<N>(fixed_alternating<N>()));
+  for (uint64_t seed = 0; seed < 20; ++seed) {
+    disk_state before = seed ? disk_state::random(N, seed) : disk_state(N);
+    auto word = fixed_from_disks<N>(before);
+    TEST_EQUAL("fixed_from_disks() round trip", before, fixed_to_disks<N>(word));
+
+    auto alternate = fixed_sort_alternate<N>(word);
+    auto expected = sort_alternate(before);
+    TEST_EQUAL("fixed alternate swaps", expected.swap_count(), alternate.swap_count);
+    TEST_EQUAL("fixed alternate row", expected.after(), fixed_to_disks<N>(alternate.after));
+
+    auto lawnmower = fixed_sort_lawnmower<N>(word);
+    expected = sort_lawnmower(before);
+    TEST_EQUAL("fixed lawnmower swaps", expected.swap_count(), lawnmower.swap_count);
+    TEST_EQUAL("fixed lawnmower row", expected.after(), fixed_to_disks<N>(lawnmower.after));
+    TEST_EQUAL("fixed_is_sorted()", expected.after().is_sorted(), fixed_is_sorted<N>(lawnmower.after));
+  }
+}
 
 int main() {
 
@@ -88,6 +226,26 @@ int main() {
              TEST_TRUE("is_sorted() after swaps", sorted_three.is_sorted());
            });
 
+  rubric.criterion("word-wise checks match element-wise checks", 1,
+     		   [&]() {
+             for (size_t n : {1, 2, 31, 32, 33, 63, 64, 65, 96, 127, 128, 129, 300, 600}) {
+               std::vector<disk_state> rows = { disk_state(n), sort_counting(disk_state(n)).after(),
+                                                disk_state::random(n, n), disk_state::worst_case(n) };
+               for (size_t i = 0; i + 1 < 2 * n; i += 7) {
+                 disk_state swapped = rows[0];
+                 swapped.swap(i);
+                 rows.push_back(swapped);
+                 swapped = rows[1];
+                 swapped.swap(i);
+                 rows.push_back(swapped);
+               }
+               for (auto& row : rows) {
+                 TEST_EQUAL("is_initialized", reference_is_initialized(row), row.is_initialized());
+                 TEST_EQUAL("is_sorted", reference_is_sorted(row), row.is_sorted());
+               }
+             }
+           });
+
   rubric.criterion("alternate, n=3", 1,
      		   [&]() {
              auto output = sort_alternate(disk_state(3));
@@ -154,5 +312,466 @@ int main() {
              TEST_EQUAL("n=100 gives 5050 swaps", 5050, trial(100));
            });
 
+  rubric.criterion("bit-packed passes match element-wise passes", 1,
+     		   [&]() {
+             for (unsigned n = 1; n <= 100; n += 3) {
+               for (unsigned seed = 0; seed < 4; ++seed) {
+                 disk_state packed(n);
+                 scramble(packed, seed);
+                 disk_state reference(packed);
+                 for (unsigned pass = 0; pass < 6; ++pass) {
+                   TEST_EQUAL("alternate pass swaps", reference_alternate_pass(reference, pass % 2), packed.alternate_pass(pass % 2));
+                   TEST_EQUAL("alternate pass state", reference, packed);
+                 }
+                 scramble(packed, seed + 7);
+                 reference = packed;
+                 for (unsigned pass = 0; pass < 3; ++pass) {
+                   TEST_EQUAL("forward pass swaps", reference_forward_pass(reference), packed.lawnmower_forward_pass());
+                   TEST_EQUAL("forward pass state", reference, packed);
+                   TEST_EQUAL("backward pass swaps", reference_backward_pass(reference), packed.lawnmower_backward_pass());
+                   TEST_EQUAL("backward pass state", reference, packed);
+                 }
+               }
+             }
+           });
+
+  rubric.criterion("counting matches simulated algorithms", 1,
+     		   [&]() {
+             for (unsigned n = 1; n <= 100; ++n) {
+               auto counting = sort_counting(disk_state(n));
+               auto alternate = sort_alternate(disk_state(n));
+               auto lawnmower = sort_lawnmower(disk_state(n));
+               TEST_TRUE("actually sorted", counting.after().is_sorted());
+               TEST_EQUAL("same state as alternate", alternate.after(), counting.after());
+               TEST_EQUAL("same swaps as alternate", alternate.swap_count(), counting.swap_count());
+               TEST_EQUAL("same state as lawnmower", lawnmower.after(), counting.after());
+               TEST_EQUAL("same swaps as lawnmower", lawnmower.swap_count(), counting.swap_count());
+             }
+             for (unsigned seed = 0; seed < 20; ++seed) {
+               disk_state reference(37 + seed);
+               scramble(reference, seed);
+               auto counting = sort_counting(reference);
+               uint64_t swaps = 0, pass_swaps;
+               do {
+                 pass_swaps = reference_forward_pass(reference);
+                 swaps += pass_swaps;
+               } while (pass_swaps > 0);
+               TEST_EQUAL("scrambled state", reference, counting.after());
+               TEST_EQUAL("scrambled swaps", swaps, counting.swap_count());
+             }
+           });
+
+  rubric.criterion("adaptive matches simulated algorithms", 1,
+     		   [&]() {
+             for (unsigned n = 1; n <= 100; ++n) {
+               for (unsigned seed = 0; seed < 3; ++seed) {
+                 disk_state before(n);
+                 if (seed > 0) {
+                   scramble(before, seed);
+                 }
+                 auto alternate = sort_alternate(before);
+                 auto alternate_adaptive = sort_alternate_adaptive(before);
+                 TEST_EQUAL("same state as alternate", alternate.after(), alternate_adaptive.after());
+                 TEST_EQUAL("same swaps as alternate", alternate.swap_count(), alternate_adaptive.swap_count());
+                 auto lawnmower = sort_lawnmower(before);
+                 auto lawnmower_adaptive = sort_lawnmower_adaptive(before);
+                 TEST_EQUAL("same state as lawnmower", lawnmower.after(), lawnmower_adaptive.after());
+                 TEST_EQUAL("same swaps as lawnmower", lawnmower.swap_count(), lawnmower_adaptive.swap_count());
+               }
+             }
+             auto sorted = sort_counting(disk_state(1000)).after();
+             TEST_EQUAL("alternate on sorted row", 0, sort_alternate_adaptive(sorted).swap_count());
+             TEST_EQUAL("lawnmower on sorted row", 0, sort_lawnmower_adaptive(sorted).swap_count());
+           });
+
+  rubric.criterion("parallel alternate matches alternate", 1,
+     		   [&]() {
+             for (unsigned threads = 1; threads <= 5; ++threads) {
+               for (unsigned n : {1u, 40u, 64u, 100u, 333u, 1000u}) {
+                 disk_state before(n);
+                 if (n % 2 == 0) {
+                   scramble(before, n + threads);
+                 }
+                 auto alternate = sort_alternate(before);
+                 auto parallel = sort_alternate_parallel(before, threads);
+                 TEST_EQUAL("same state", alternate.after(), parallel.after());
+                 TEST_EQUAL("same swaps", alternate.swap_count(), parallel.swap_count());
+               }
+             }
+           });
+
+  rubric.criterion("AVX2 backend matches scalar backend", 1,
+     		   [&]() {
+             for (unsigned n = 1; n <= 700; n += 23) {
+               for (unsigned seed = 0; seed < 3; ++seed) {
+                 disk_state scalar(n);
+                 scramble(scalar, seed);
+                 disk_state avx2(scalar);
+                 for (unsigned pass = 0; pass < 4; ++pass) {
+                   TEST_EQUAL("alternate pass swaps", scalar.alternate_pass(pass % 2, BACKEND_SCALAR), avx2.alternate_pass(pass % 2, BACKEND_AVX2));
+                   TEST_EQUAL("alternate pass state", scalar, avx2);
+                   TEST_EQUAL("forward pass swaps", scalar.lawnmower_forward_pass(BACKEND_SCALAR), avx2.lawnmower_forward_pass(BACKEND_AVX2));
+                   TEST_EQUAL("forward pass state", scalar, avx2);
+                   TEST_EQUAL("backward pass swaps", scalar.lawnmower_backward_pass(BACKEND_SCALAR), avx2.lawnmower_backward_pass(BACKEND_AVX2));
+                   TEST_EQUAL("backward pass state", scalar, avx2);
+                 }
+                 TEST_EQUAL("adaptive alternate", sort_alternate_adaptive(scalar, BACKEND_SCALAR).swap_count(), sort_alternate_adaptive(scalar, BACKEND_AVX2).swap_count());
+                 TEST_EQUAL("adaptive lawnmower", sort_lawnmower_adaptive(scalar, BACKEND_SCALAR).after(), sort_lawnmower_adaptive(scalar, BACKEND_AVX2).after());
+                 TEST_EQUAL("parallel alternate", sort_alternate_parallel(scalar, 3, BACKEND_SCALAR).after(), sort_alternate_parallel(scalar, 3, BACKEND_AVX2).after());
+               }
+               TEST_EQUAL("alternate", sort_alternate(disk_state(n), BACKEND_SCALAR).swap_count(), sort_alternate(disk_state(n), BACKEND_AVX2).swap_count());
+               TEST_EQUAL("lawnmower", sort_lawnmower(disk_state(n), BACKEND_SCALAR).swap_count(), sort_lawnmower(disk_state(n), BACKEND_AVX2).swap_count());
+             }
+           });
+
+  rubric.criterion("swap visitors see every swap in order", 1,
+     		   [&]() {
+             for (unsigned n : {1u, 5u, 32u, 33u, 100u, 170u}) {
+               disk_state before(n);
+               scramble(before, n);
+
+               std::vector<size_t> expected, visited;
+               disk_state reference(before);
+               for (unsigned a = 0; a < n; a += 2) {
+                 reference_alternate_pass(reference, 0, &expected);
+                 reference_alternate_pass(reference, 1, &expected);
+               }
+               auto alternate = sort_alternate(before, [&](size_t i) { visited.push_back(i); });
+               TEST_EQUAL("alternate swap count", expected.size(), alternate.swap_count());
+               TEST_TRUE("alternate swap indices", expected == visited);
+               TEST_EQUAL("alternate state", reference, alternate.after());
+
+               expected.clear();
+               visited.clear();
+               reference = before;
+               for (unsigned a = 0; a < n; a += 2) {
+                 reference_forward_pass(reference, &expected);
+                 reference_backward_pass(reference, &expected);
+               }
+               auto lawnmower = sort_lawnmower(before, [&](size_t i) { visited.push_back(i); });
+               TEST_EQUAL("lawnmower swap count", expected.size(), lawnmower.swap_count());
+               TEST_TRUE("lawnmower swap indices", expected == visited);
+               TEST_EQUAL("lawnmower state", reference, lawnmower.after());
+             }
+
+             std::stringstream log;
+             {
+               swap_stream_writer writer(log);
+               sort_alternate(disk_state(100), writer);
+             }
+             TEST_EQUAL("streamed log size", 5050 * sizeof(uint64_t), log.str().size());
+           });
+
+  rubric.criterion("disk_state factories", 1,
+     		   [&]() {
+             for (unsigned n : {1u, 3u, 32u, 33u, 100u}) {
+               auto random = disk_state::random(n, 42);
+               TEST_EQUAL("random total_count()", 2 * n, random.total_count());
+               TEST_EQUAL("random is reproducible", random, disk_state::random(n, 42));
+               TEST_EQUAL("from_string(to_string())", random, disk_state::from_string(random.to_string()));
+               TEST_EQUAL("from_bitmap(word_data())", random, disk_state::from_bitmap(random.word_data(), random.total_count()));
+
+               TEST_TRUE("best_case() is sorted", disk_state::best_case(n).is_sorted());
+               TEST_EQUAL("best_case() inversions", 0, disk_state::best_case(n).inversion_count());
+               TEST_EQUAL("worst_case() inversions", uint64_t(n) * n, disk_state::worst_case(n).inversion_count());
+               TEST_EQUAL("worst_case() starts light", DISK_LIGHT, disk_state::worst_case(n).get(0));
+               TEST_EQUAL("worst_case() ends dark", DISK_DARK, disk_state::worst_case(n).get(2 * n - 1));
+             }
+             TEST_FALSE("different seeds", disk_state::random(100, 1) == disk_state::random(100, 2));
+             TEST_EQUAL("from_string() without spaces", disk_state(3), disk_state::from_string("LDLDLD"));
+
+             size_t light_first = 0;
+             for (unsigned seed = 0; seed < 1000; ++seed) {
+               light_first += (disk_state::random(5, seed).get(0) == DISK_LIGHT);
+             }
+             TEST_TRUE("random first disk is light about half the time", light_first > 400 && light_first < 600);
+
+             bool threw = false;
+             try { disk_state::from_string("L D X D"); } catch (const std::invalid_argument&) { threw = true; }
+             TEST_TRUE("from_string() rejects other characters", threw);
+             threw = false;
+             try { disk_state::from_string("L L D"); } catch (const std::invalid_argument&) { threw = true; }
+             TEST_TRUE("from_string() rejects unequal counts", threw);
+             threw = false;
+             try { disk_state::from_string(""); } catch (const std::invalid_argument&) { threw = true; }
+             TEST_TRUE("from_string() rejects empty rows", threw);
+           });
+
+  rubric.criterion("streaming text output and parsing", 1,
+     		   [&]() {
+             for (size_t n : {1, 3, 4, 5, 31, 32, 33, 100, 2047, 2048, 2049, 5000}) {
+               auto row = disk_state::random(n, n);
+               std::string expected;
+               for (size_t i = 0; i < row.total_count(); ++i) {
+                 expected += (i ? " " : "");
+                 expected += (row.get(i) == DISK_LIGHT) ? "L" : "D";
+               }
+               TEST_EQUAL("to_string()", expected, row.to_string());
+               TEST_EQUAL("text_size()", expected.size(), row.text_size());
+
+               std::vector<char> buffer(row.text_size());
+               TEST_EQUAL("write_text(buffer) length", expected.size(), row.write_text(buffer.data()));
+               TEST_EQUAL("write_text(buffer)", expected, std::string(buffer.begin(), buffer.end()));
+
+               std::ostringstream out;
+               row.write_text(out);
+               TEST_EQUAL("write_text(ostream)", expected, out.str());
+               TEST_EQUAL("from_text()", row, disk_state::from_text(expected.data(), expected.size()));
+
+               std::string messy = expected;
+               messy.insert(messy.size() / 3 + 1, "\n ");
+               TEST_EQUAL("from_text() with extra whitespace", row, disk_state::from_text(messy.data(), messy.size()));
+
+               bool threw = false;
+               messy = expected;
+               messy[messy.size() / 2 & ~size_t(1)] = 'X';
+               try { disk_state::from_text(messy.data(), messy.size()); } catch (const std::invalid_argument&) { threw = true; }
+               TEST_TRUE("from_text() rejects other characters", threw);
+             }
+             TEST_EQUAL("from_text() with other whitespace", disk_state(2),
+                        disk_state::from_text("L\tD\n LD\n", 8));
+
+             const std::string path = "disks_io_test.txt";
+             auto row = disk_state::random(3000, 7);
+             save_disks_text(row, path);
+             TEST_EQUAL("load_disks_text(save_disks_text())", row, load_disks_text(path));
+             std::remove(path.c_str());
+
+             bool threw = false;
+             try { load_disks_text(path); } catch (const std::runtime_error&) { threw = true; }
+             TEST_TRUE("load_disks_text() of a missing file throws", threw);
+           });
+
+  rubric.criterion("snapshots resume interrupted sorts", 1,
+     		   [&]() {
+             const std::string path = "disks_snapshot_test.bin";
+             auto before = disk_state::random(300, 11);
+
+             disk_snapshot snapshot { before, SNAPSHOT_LAWNMOWER, 0, 0 };
+             advance_snapshot(snapshot, 123);
+             save_disks_snapshot(snapshot, path);
+             auto loaded = load_disks_snapshot(path);
+             TEST_EQUAL("loaded row", snapshot.row, loaded.row);
+             TEST_EQUAL("loaded algorithm", SNAPSHOT_LAWNMOWER, loaded.algorithm);
+             TEST_EQUAL("loaded pass", 123, loaded.pass);
+             TEST_EQUAL("loaded swap count", snapshot.swap_count, loaded.swap_count);
+
+             auto expected = sort_lawnmower(before);
+             auto resumed = sort_resumable(before, SNAPSHOT_LAWNMOWER, path, 50);
+             TEST_EQUAL("resumed lawnmower row", expected.after(), resumed.after());
+             TEST_EQUAL("resumed lawnmower swaps", expected.swap_count(), resumed.swap_count());
+
+             bool removed = false;
+             try { load_disks_snapshot(path); } catch (const std::runtime_error&) { removed = true; }
+             TEST_TRUE("snapshot removed when done", removed);
+
+             for (uint64_t every : {1, 7, 1000}) {
+               auto fresh = sort_resumable(before, SNAPSHOT_ALTERNATE, path, every);
+               TEST_EQUAL("alternate row", sort_alternate(before).after(), fresh.after());
+               TEST_EQUAL("alternate swaps", sort_alternate(before).swap_count(), fresh.swap_count());
+             }
+
+             save_disks_snapshot(snapshot, path);
+             bool threw = false;
+             try { sort_resumable(before, SNAPSHOT_ALTERNATE, path, 10); } catch (const std::invalid_argument&) { threw = true; }
+             TEST_TRUE("snapshot of a different algorithm rejected", threw);
+
+             std::ofstream(path, std::ios::binary | std::ios::trunc) << "DISKSNAP but not really";
+             threw = false;
+             try { load_disks_snapshot(path); } catch (const std::invalid_argument&) { threw = true; }
+             TEST_TRUE("corrupt snapshot rejected", threw);
+             std::remove(path.c_str());
+           });
+
+  rubric.criterion("colored counting matches simulated sorting", 1,
+     		   [&]() {
+             for (size_t k : {1, 2, 3, 7, 256}) {
+               std::vector<uint8_t> reversed;
+               for (size_t c = k; c > 0; --c) {
+                 reversed.push_back(uint8_t(c - 1));
+               }
+               color_order<> order(reversed);
+               for (size_t n : {0, 1, 2, 50, 333}) {
+                 auto before = colored_disk_state<>::random(n, k, n * k);
+                 auto counted = sort_colors_counting(before, order);
+                 auto simulated = sort_colors_lawnmower(before, order);
+                 TEST_EQUAL("swap count", simulated.swap_count(), counted.swap_count());
+                 TEST_TRUE("sorted row", simulated.after() == counted.after());
+                 TEST_TRUE("is_sorted()", counted.after().is_sorted(order));
+               }
+             }
+
+             color_order<> dark_first({ DISK_DARK, DISK_LIGHT });
+             for (size_t n : {1, 4, 33}) {
+               auto row = disk_state::random(n, n);
+               TEST_EQUAL("two colors match sort_counting", sort_counting(row).swap_count(),
+                          sort_colors_counting(colored_disk_state<>::from_disks(row), dark_first).swap_count());
+             }
+
+             color_order<uint16_t> wide({ 1000, 3, 70 });
+             colored_disk_state<uint16_t> wide_row({ 70, 3, 1000, 70, 1000 });
+             TEST_EQUAL("uint16_t colors", 6, sort_colors_counting(wide_row, wide).swap_count());
+
+             bool threw = false;
+             try { color_order<>({ 1, 2, 1 }); } catch (const std::invalid_argument&) { threw = true; }
+             TEST_TRUE("repeated color rejected", threw);
+             threw = false;
+             try { sort_colors_counting(colored_disk_state<>({ 0, 5 }), dark_first); } catch (const std::invalid_argument&) { threw = true; }
+             TEST_TRUE("color missing from order rejected", threw);
+           });
+
+  rubric.criterion("fixed-size sorters match", 1,
+     		   [&]() {
+             check_fixed_sorters<1>();
+             check_fixed_sorters<2>();
+             check_fixed_sorters<3>();
+             check_fixed_sorters<7>();
+             check_fixed_sorters<31>();
+             check_fixed_sorters<32>();
+             check_fixed_sorters<33>();
+             check_fixed_sorters<50>();
+             check_fixed_sorters<63>();
+             check_fixed_sorters<64>();
+           });
+
+  rubric.criterion("pass statistics", 1,
+     		   [&]() {
+             auto before = disk_state::random(40, 3);
+             pass_stats stats;
+             auto sorted = sort_lawnmower(before, ignore_swaps(), BACKEND_AUTO, stats);
+             TEST_EQUAL("lawnmower passes", sort_pass_count(80), stats.records().size());
+             TEST_EQUAL("lawnmower swaps", sorted.swap_count(), stats.total_swaps());
+             TEST_EQUAL("lawnmower compares", 20 * (79 + 78), stats.total_compares());
+
+             disk_state row = before;
+             size_t noops = 0;
+             for (size_t pass = 0; pass < sort_pass_count(80); ++pass) {
+               size_t swaps = (pass % 2 == 0) ? reference_forward_pass(row) : reference_backward_pass(row);
+               TEST_EQUAL("swaps in pass", swaps, stats.records()[pass].swaps);
+               noops += (swaps == 0);
+             }
+             TEST_EQUAL("noop passes", noops, stats.noop_passes());
+
+             stats.clear();
+             std::vector<size_t> log;
+             sort_alternate(disk_state(5), [&](size_t i) { log.push_back(i); }, BACKEND_AUTO, stats);
+             TEST_EQUAL("alternate passes", 6, stats.records().size());
+             TEST_EQUAL("alternate swaps", log.size(), stats.total_swaps());
+             TEST_EQUAL("alternate compares", 5 + 4 + 5 + 4 + 5 + 4, stats.total_compares());
+             TEST_EQUAL("alternate noop passes", 1, stats.noop_passes());
+
+             std::ostringstream csv, json;
+             stats.write_csv(csv);
+             stats.write_json(json);
+             TEST_EQUAL("csv header", 0, csv.str().find("pass,compares,swaps,seconds\n0,5,"));
+             std::string csv_text = csv.str();
+             TEST_EQUAL("csv lines", 7, std::count(csv_text.begin(), csv_text.end(), '\n'));
+             TEST_EQUAL("json totals", 0, json.str().find("{\"passes\":6,\"noop_passes\":1,\"compares\":27,\"swaps\":15,"));
+           });
+
+  rubric.criterion("fused lawnmower matches lawnmower", 1,
+     		   [&]() {
+             for (size_t n : {1, 2, 3, 31, 32, 33, 64, 65, 200}) {
+               std::vector<disk_state> rows = { disk_state(n), disk_state::random(n, n),
+                                                disk_state::worst_case(n), disk_state::best_case(n) };
+               for (auto& before : rows) {
+                 auto expected = sort_lawnmower(before);
+                 auto fused = sort_lawnmower_fused(before);
+                 TEST_EQUAL("swap count", expected.swap_count(), fused.swap_count());
+                 TEST_EQUAL("row", expected.after(), fused.after());
+               }
+             }
+             const uint64_t n = 1000000;
+             TEST_EQUAL("large alternating row", n * (n + 1) / 2, sort_lawnmower_fused(disk_state(n)).swap_count());
+           });
+
+  rubric.criterion("sorting allocates at most one row", 1,
+     		   [&]() {
+             disk_state row(5000);
+             size_t row_bytes = row.word_count() * sizeof(uint64_t);
+
+             size_t baseline = live_bytes;
+             peak_bytes = baseline;
+             uint64_t swaps = sort_alternate_inplace(row);
+             TEST_EQUAL("in-place alternate swaps", 12502500, swaps);
+             TEST_TRUE("in-place alternate sorted", row.is_sorted());
+             TEST_EQUAL("in-place alternate allocates nothing", baseline, peak_bytes.load());
+
+             row = disk_state(5000);
+             peak_bytes = baseline;
+             swaps = sort_lawnmower_inplace(row);
+             TEST_EQUAL("in-place lawnmower swaps", 12502500, swaps);
+             TEST_EQUAL("in-place lawnmower allocates nothing", baseline, peak_bytes.load());
+
+             const disk_state before(5000);
+             baseline = live_bytes;
+             peak_bytes = baseline;
+             {
+               auto output = sort_alternate(before);
+               TEST_EQUAL("alternate result holds one row", baseline + row_bytes, live_bytes.load());
+             }
+             TEST_EQUAL("alternate peak is one row", baseline + row_bytes, peak_bytes.load());
+
+             peak_bytes = baseline;
+             {
+               auto output = sort_lawnmower(before);
+             }
+             TEST_EQUAL("lawnmower peak is one row", baseline + row_bytes, peak_bytes.load());
+           });
+
+  rubric.criterion("batch sorting matches one row at a time", 1,
+     		   [&]() {
+             disk_batch batch;
+             std::vector<disk_state> rows;
+             for (size_t r = 0; r < 40; ++r) {
+               size_t n = 1 + (r * 37) % 300;
+               rows.push_back(r % 3 ? disk_state::random(n, r) : disk_state(n));
+               batch.add(rows.back());
+             }
+             TEST_EQUAL("row count", rows.size(), batch.row_count());
+             TEST_TRUE("row copies back out", batch.row(7) == rows[7]);
+
+             for (unsigned threads = 1; threads <= 4; ++threads) {
+               for (auto algorithm : { BATCH_ALTERNATE, BATCH_LAWNMOWER }) {
+                 disk_batch sorted = batch;
+                 std::vector<uint64_t> counts(rows.size());
+                 sort_batch(sorted, algorithm, counts.data(), threads);
+                 for (size_t r = 0; r < rows.size(); ++r) {
+                   auto expected = (algorithm == BATCH_ALTERNATE) ? sort_alternate(rows[r])
+                                                                  : sort_lawnmower(rows[r]);
+                   TEST_EQUAL("swap count", expected.swap_count(), counts[r]);
+                   TEST_TRUE("row", expected.after() == sorted.row(r));
+                 }
+               }
+             }
+
+             disk_batch big;
+             big.reserve(64, 64 * disk_state(2000).word_count());
+             for (size_t r = 0; r < 64; ++r) {
+               big.add(disk_state(2000));
+             }
+             std::vector<uint64_t> counts(big.row_count());
+             size_t baseline = live_bytes;
+             peak_bytes = baseline;
+             sort_batch(big, BATCH_LAWNMOWER, counts.data(), 1);
+             TEST_EQUAL("batch swap count", 2001000, counts[63]);
+             TEST_LT("batch allocates no rows", peak_bytes.load() - baseline,
+                     disk_state(2000).word_count() * sizeof(uint64_t));
+           });
+
+  rubric.criterion("swap counts past 2^32", 1,
+     		   [&]() {
+             const uint64_t n = 92700, expected = n * (n + 1) / 2;
+             TEST_GT("expected count needs 64 bits", expected, uint64_t(1) << 32);
+
+             sorted_disks big(disk_state(1), expected);
+             TEST_EQUAL("sorted_disks keeps 64-bit counts", expected, big.swap_count());
+             TEST_EQUAL("counting", expected, sort_counting(disk_state(n)).swap_count());
+
+             disk_state row(n);
+             TEST_EQUAL("in-place lawnmower", expected, sort_lawnmower_inplace(row));
+             TEST_TRUE("in-place lawnmower sorted", row.is_sorted());
+           });
+
   return rubric.run();
 }
@@ -0,0 +1,247 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//******************************
+// Open-addressing hash table
+//******************************
+
+// Hash table from integer keys to values, stored flat: keys, values and
+// slot occupancy live in three parallel arrays, so an insert allocates
+// nothing unless the table grows, and a lookup walks consecutive keys
+// rather than chasing list nodes.
+//
+// Slots are chosen by multiplying the key by a large odd constant, with
+// linear probing on collisions; erase shifts the following entries back, so
+// there are no tombstones. The Hash function given to the constructor is
+// only used for bucket statistics: bucket_size(n) is the number of keys
+// whose hash, modulo bucket_count(), is n, as it would be for an
+// std::unordered_map with that many buckets. It is called once per insert
+// and erase, never on a lookup, and not at all by the overloads that take
+// the key's hash precomputed. The smallest and largest bucket sizes are
+// kept up to date by every insert and erase, so reading them costs O(1).
+template <typename Key, typename Value, typename Hash>
+class FlatHashTable {
+  static_assert(std::is_integral<Key>::value, "FlatHashTable keys must be integers");
+
+public:
+  FlatHashTable(size_t bucket_count, Hash hash):
+    hash_(hash), bucketSizes_(bucket_count, 0), bucketsOfSize_(1, bucket_count),
+    minBucketSize_(0), maxBucketSize_(0), size_(0), shift_(0) {
+    rehash(MIN_SLOTS);
+  }
+
+  // Insert entry unless its key is already present. Returns true if it was
+  // inserted.
+  bool insert(const std::pair<Key, Value>& entry) {
+    return insert(std::pair<Key, Value>(entry));
+  }
+
+  bool insert(std::pair<Key, Value>&& entry) {
+    size_t hash = hash_(entry.first);
+    return insert(std::move(entry), hash);
+  }
+
+  // The same, given hash, the value the Hash function returns for the key,
+  // already computed, for instance for a whole batch of keys at once.
+  bool insert(std::pair<Key, Value>&& entry, size_t hash) {
+    if ((size_ + 1) * 4 > keys_.size() * 3) {   // keep the load factor at most 3/4
+      rehash(keys_.size() * 2);
+    }
+    size_t slot = home(entry.first);
+    for (; used_[slot]; slot = next(slot)) {
+      if (keys_[slot] == entry.first) {
+        return false;
+      }
+    }
+    keys_[slot] = entry.first;
+    values_[slot] = std::move(entry.second);
+    used_[slot] = 1;
+    growBucket(hash % bucketSizes_.size());
+    size_++;
+    return true;
+  }
+
+  // The scrambled key whose top bits pick the slot a key probes first, in
+  // a table of any size. Inserting many keys in increasing order of
+  // scramble(key) walks through the arrays from front to back instead of
+  // jumping all over them, which is far kinder to the cache and TLB.
+  static uint64_t scramble(Key key) {
+    return uint64_t(key) * 0x9E3779B97F4A7C15ULL;
+  }
+
+  // Remove key; returns the number of entries removed, 0 or 1.
+  size_t erase(Key key) {
+    return erase(key, hash_(key));
+  }
+
+  // The same, given the key's hash already computed, as for insert.
+  size_t erase(Key key, size_t hash) {
+    size_t slot = home(key);
+    while (used_[slot] && keys_[slot] != key) {
+      slot = next(slot);
+    }
+    if (!used_[slot]) {
+      return 0;
+    }
+    shrinkBucket(hash % bucketSizes_.size());
+    size_--;
+
+    // shift back every following entry that may move closer to its home
+    // slot, so no probe sequence passes over an empty slot
+    size_t gap = slot;
+    for (size_t probe = next(gap); used_[probe]; probe = next(probe)) {
+      if (((probe - home(keys_[probe])) & mask()) >= ((probe - gap) & mask())) {
+        keys_[gap] = keys_[probe];
+        values_[gap] = std::move(values_[probe]);
+        gap = probe;
+      }
+    }
+    used_[gap] = 0;
+    values_[gap] = Value();
+    return 1;
+  }
+
+  // Pointer to the value stored for key, or nullptr if there is none.
+  Value* find(Key key) {
+    for (size_t slot = home(key); used_[slot]; slot = next(slot)) {
+      if (keys_[slot] == key) {
+        return &values_[slot];
+      }
+    }
+    return nullptr;
+  }
+
+  const Value* find(Key key) const {
+    return const_cast<FlatHashTable*>(this)->find(key);
+  }
+
+  size_t count(Key key) const {
+    return find(key) ? 1 : 0;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  // Make room for n entries without growing again.
+  void reserve(size_t n) {
+    size_t slots = keys_.size();
+    while (n * 4 > slots * 3) {
+      slots *= 2;
+    }
+    if (slots != keys_.size()) {
+      rehash(slots);
+    }
+  }
+
+  size_t bucket_count() const {
+    return bucketSizes_.size();
+  }
+
+  size_t bucket_size(size_t n) const {
+    return bucketSizes_[n];
+  }
+
+  // The smallest and largest bucket_size(n) over every bucket.
+  size_t min_bucket_size() const {
+    return minBucketSize_;
+  }
+
+  size_t max_bucket_size() const {
+    return maxBucketSize_;
+  }
+
+private:
+  static const size_t MIN_SLOTS = 16;
+
+  Hash hash_;
+  std::vector<Key> keys_;
+  std::vector<Value> values_;
+  std::vector<unsigned char> used_;
+  std::vector<size_t> bucketSizes_;
+  std::vector<size_t> bucketsOfSize_;   // bucketsOfSize_[k] buckets have size k
+  size_t minBucketSize_, maxBucketSize_;
+  size_t size_;
+  unsigned shift_;
+
+  size_t mask() const {
+    return keys_.size() - 1;
+  }
+
+  size_t next(size_t slot) const {
+    return (slot + 1) & mask();
+  }
+
+  // Fibonacci hashing: the top bits of the key times 2^64 / phi.
+  size_t home(Key key) const {
+    return scramble(key) >> shift_;
+  }
+
+  // A bucket's size only ever moves by one, so the minimum and maximum
+  // move by at most one, and only when the bucket was the last of its size
+  // or is the new extreme.
+  void growBucket(size_t bucket) {
+    size_t k = bucketSizes_[bucket]++;
+    if (k + 1 == bucketsOfSize_.size()) {
+      bucketsOfSize_.push_back(0);
+    }
+    bucketsOfSize_[k]--;
+    bucketsOfSize_[k + 1]++;
+    if (k == maxBucketSize_) {
+      maxBucketSize_ = k + 1;
+    }
+    if (k == minBucketSize_ && bucketsOfSize_[k] == 0) {
+      minBucketSize_ = k + 1;
+    }
+  }
+
+  void shrinkBucket(size_t bucket) {
+    size_t k = bucketSizes_[bucket]--;
+    bucketsOfSize_[k]--;
+    bucketsOfSize_[k - 1]++;
+    if (k == minBucketSize_) {
+      minBucketSize_ = k - 1;
+    }
+    if (k == maxBucketSize_ && bucketsOfSize_[k] == 0) {
+      maxBucketSize_ = k - 1;
+    }
+  }
+
+  void place(Key key, Value&& value) {
+    size_t slot = home(key);
+    while (used_[slot]) {
+      slot = next(slot);
+    }
+    keys_[slot] = key;
+    values_[slot] = std::move(value);
+    used_[slot] = 1;
+  }
+
+  // Move every entry into a table of slots slots, a power of two.
+  void rehash(size_t slots) {
+    std::vector<Key> keys(slots);
+    std::vector<Value> values(slots);
+    std::vector<unsigned char> used(slots, 0);
+    keys.swap(keys_);
+    values.swap(values_);
+    used.swap(used_);
+
+    shift_ = 64;
+    for (size_t s = slots; s > 1; s /= 2) {
+      shift_--;
+    }
+    for (size_t i = 0; i < used.size(); ++i) {
+      if (used[i]) {
+        place(keys[i], std::move(values[i]));
+      }
+    }
+  }
+};
@@ -2,6 +2,18 @@
 #include <iostream>
 #include <fstream>
 #include <stdexcept>
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "GlassesDisplay.hpp"
 
 using std::string;
@@ -66,6 +78,72 @@ unsigned int hashfct7(unsigned int barcode) {
 }
 
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GLASSES_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// x / 10 for any unsigned int x, as a multiply and a shift: 0xCCCCCCCD is
+// 2^35 / 10 rounded up, and the rounding error never reaches the quotient.
+const uint64_t DIV10_MAGIC = 0xCCCCCCCDULL;
+const unsigned DIV10_SHIFT = 35;
+
+void hashfctAllScalar(const unsigned int* barcodes, size_t begin, size_t count, unsigned char* digits) {
+  for (size_t i = begin; i < count; ++i) {
+    unsigned int x = barcodes[i];
+    for (size_t k = 7; k-- > 0; ) {
+      unsigned int q = (x * DIV10_MAGIC) >> DIV10_SHIFT;
+      digits[k * count + i] = x - q * 10;
+      x = q;
+    }
+  }
+}
+
+#ifdef GLASSES_HAVE_AVX2
+// Eight barcodes per register. _mm256_mul_epu32 only multiplies the even
+// 32-bit lanes, so the odd lanes are shifted down and multiplied separately,
+// and the two sets of quotients blended back together.
+__attribute__((target("avx2")))
+size_t hashfctAllAvx2(const unsigned int* barcodes, size_t count, unsigned char* digits) {
+  const __m256i magic = _mm256_set1_epi64x(DIV10_MAGIC);
+  const __m256i ten = _mm256_set1_epi32(10);
+  // low byte of each 32-bit lane into the low 4 bytes of its 128-bit half,
+  // then the two halves side by side
+  const __m256i lowBytes = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                            0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+  const __m256i joinHalves = _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0);
+
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(barcodes + i));
+    for (size_t k = 7; k-- > 0; ) {
+      __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(x, magic), DIV10_SHIFT);
+      __m256i odd = _mm256_srli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), magic), DIV10_SHIFT);
+      __m256i q = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+      __m256i d = _mm256_sub_epi32(x, _mm256_mullo_epi32(q, ten));
+      d = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(d, lowBytes), joinHalves);
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(digits + k * count + i), _mm256_castsi256_si128(d));
+      x = q;
+    }
+  }
+  return i;
+}
+#endif
+
+} // namespace
+
+void hashfctAll(const unsigned int* barcodes, size_t count, unsigned char* digits) {
+  size_t done = 0;
+#ifdef GLASSES_HAVE_AVX2
+  static const bool avx2 = __builtin_cpu_supports("avx2");
+  if (avx2)
+    done = hashfctAllAvx2(barcodes, count, digits);
+#endif
+  hashfctAllScalar(barcodes, done, count, digits);
+}
+
 // Constructor for struct Item
 Glasses::Glasses(string glassesColor, string glassesShape, string glassesBrand, unsigned int barcode): glassesColor_(glassesColor), glassesShape_(glassesShape), glassesBrand_(glassesBrand), barcode_(barcode)
 {};
@@ -91,21 +169,231 @@ void GlassesDisplay::readTextfile(string filename) {
     throw std::invalid_argument("Could not open file " + filename);
 }
 
+namespace {
+
+// read-only memory mapping of a whole file, unmapped when destroyed
+class MappedFile {
+public:
+  explicit MappedFile(const string& filename): data_(nullptr), size_(0) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw std::invalid_argument("Could not open file " + filename);
+    struct stat info;
+    bool ok = (fstat(fd, &info) == 0);
+    if (ok && info.st_size > 0) {
+      void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      ok = (data != MAP_FAILED);
+      if (ok) {
+        madvise(data, info.st_size, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(data);
+        size_ = info.st_size;
+      }
+    }
+    close(fd);
+    if (!ok)
+      throw std::invalid_argument("Could not map file " + filename);
+  }
+
+  ~MappedFile() {
+    if (data_)
+      munmap(const_cast<char*>(data_), size_);
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char* begin() const { return data_; }
+  const char* end() const { return data_ + size_; }
+
+private:
+  const char* data_;
+  size_t size_;
+};
+
+// the whitespace characters operator>> skips in the "C" locale
+bool isBlank(char c) {
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// advance p past whitespace and then one token, returning the token
+std::pair<const char*, const char*> nextToken(const char*& p, const char* end) {
+  while (p < end && isBlank(*p))
+    ++p;
+  const char* start = p;
+  while (p < end && !isBlank(*p))
+    ++p;
+  return {start, p};
+}
+
+} // namespace
+
+template <typename Update>
+void GlassesDisplay::forEachTable(Update update) {
+    update(hT1);
+    update(hT2);
+    update(hT3);
+    update(hT4);
+    update(hT5);
+    update(hT6);
+    update(hT7);
+}
+
+// hT2 to hT7 share nothing, so a big batch updates each on its own thread;
+// a small one is not worth starting threads for. update is given each table
+// and the number, from 1 to 6, of its row in hashfctAll's output. A table
+// whose thread cannot be started is updated on the calling thread instead,
+// so every table always sees the whole batch. An exception thrown by an
+// update is rethrown here once every table is done.
+template <typename Update>
+void GlassesDisplay::forEachOtherTable(size_t batchSize, Update update) {
+    if (batchSize < PARALLEL_BATCH)
+    {
+        update(hT2, 1);
+        update(hT3, 2);
+        update(hT4, 3);
+        update(hT5, 4);
+        update(hT6, 5);
+        update(hT7, 6);
+        return;
+    }
+
+    std::exception_ptr errors[6];
+    std::thread workers[6];
+    auto run = [&](auto& table, size_t fct) {
+        auto* t = &table;
+        auto task = [&, t, fct]() {
+            try { update(*t, fct); } catch (...) { errors[fct - 1] = std::current_exception(); }
+        };
+        try { workers[fct - 1] = std::thread(task); } catch (const std::system_error&) { task(); }
+    };
+    run(hT2, 1);
+    run(hT3, 2);
+    run(hT4, 3);
+    run(hT5, 4);
+    run(hT6, 5);
+    run(hT7, 6);
+    for (std::thread& w : workers)
+    {
+        if (w.joinable())
+            w.join();
+    }
+    for (std::exception_ptr& error : errors)
+    {
+        if (error)
+            std::rethrow_exception(error);
+    }
+}
+
+void GlassesDisplay::bulkLoadTextfile(string filename) {
+  MappedFile file(filename);
+  const char* p = file.begin();
+  const char* end = file.end();
+
+  // one record per line, so the line count bounds the number of records
+  size_t lines = 1;
+  // an empty file is mapped as nullptr, which memchr must not be given
+  for (const char* q = p; q != end && (q = static_cast<const char*>(std::memchr(q, '\n', end - q))); ++q)
+    ++lines;
+  size_t expected = size() + lines;
+  glasses_.reserve(expected);
+  forEachTable([&](auto& table) { table.reserve(expected); });
+
+  // records are parsed a batch at a time, and each batch is inserted in
+  // the order of the slots its barcodes hash to, so every table is filled
+  // from front to back rather than at random. The sort is stable, so when
+  // a barcode repeats the first record still wins, as with addGlasses.
+  const size_t BATCH = 1 << 16;
+  struct Record {
+    uint64_t order;
+    std::pair<const char*, const char*> color, shape, brand;
+    unsigned int barcode;
+  };
+  std::vector<Record> records;
+  std::vector<std::pair<unsigned int, unsigned int>> added;
+  records.reserve(BATCH);
+  added.reserve(BATCH);
+
+  auto insertBatch = [&]() {
+    std::stable_sort(records.begin(), records.end(),
+                     [](const Record& a, const Record& b) { return a.order < b.order; });
+
+    // hT1 goes first, and drops any barcode already on display
+    added.clear();
+    for (const Record& r : records) {
+      unsigned int slot = freeSlots_.empty() ? glasses_.size() : freeSlots_.back();
+      if (hT1.insert({r.barcode, slot})) {
+        storeGlasses(Glasses(string(r.color.first, r.color.second), string(r.shape.first, r.shape.second),
+                             string(r.brand.first, r.brand.second), r.barcode));
+        added.push_back({r.barcode, slot});
+      }
+    }
+    insertIntoOtherTables(added);
+    records.clear();
+  };
+
+  while (true) {
+    Record r;
+    r.color = nextToken(p, end);
+    r.shape = nextToken(p, end);
+    r.brand = nextToken(p, end);
+    auto code = nextToken(p, end);
+    if (code.first == code.second)
+      break;
+
+    unsigned long long barcode = 0;
+    const char* digit = code.first;
+    while (digit < code.second && *digit >= '0' && *digit <= '9' && barcode <= UINT_MAX)
+      barcode = barcode * 10 + (*digit++ - '0');
+    if (digit != code.second || barcode > UINT_MAX)
+      break;
+    r.barcode = barcode;
+    r.order = CustomHashTable<1>::scramble(r.barcode);
+
+    records.push_back(r);
+    if (records.size() == BATCH)
+      insertBatch();
+  }
+  insertBatch();
+
+  // ensure all hash tables have the same size after loading
+  size();
+}
+
+// store glasses in the arena, in a free slot if there is one, and return
+// its slot
+unsigned int GlassesDisplay::storeGlasses(Glasses&& glasses) {
+    if (freeSlots_.empty())
+    {
+        glasses_.push_back(std::move(glasses));
+        return glasses_.size() - 1;
+    }
+    unsigned int slot = freeSlots_.back();
+    freeSlots_.pop_back();
+    glasses_[slot] = std::move(glasses);
+    return slot;
+}
+
 void GlassesDisplay::addGlasses(string glassesColor, string glassesShape, string glassesBrand, unsigned int barcode) {
   // TO BE COMPLETED
   // function that adds the specified pair of glasses to main display (i.e., to all hash tables)
 
-    // create a Glasses object
-    Glasses new_glasses(glassesColor, glassesShape, glassesBrand, barcode);
+    // a barcode already on display is left as it is
+    if (hT1.count(barcode))
+    {
+        return;
+    }
+
+    // store the Glasses object once
+    unsigned int slot = storeGlasses(Glasses(std::move(glassesColor), std::move(glassesShape), std::move(glassesBrand), barcode));
 
-    // insert the object into each of the seven hashtables
-    hT1.insert({barcode, new_glasses});
-    hT2.insert({barcode, new_glasses});
-    hT3.insert({barcode, new_glasses});
-    hT4.insert({barcode, new_glasses});
-    hT5.insert({barcode, new_glasses});
-    hT6.insert({barcode, new_glasses});
-    hT7.insert({barcode, new_glasses});
+    // insert the slot into each of the seven hashtables
+    hT1.insert({barcode, slot});
+    hT2.insert({barcode, slot});
+    hT3.insert({barcode, slot});
+    hT4.insert({barcode, slot});
+    hT5.insert({barcode, slot});
+    hT6.insert({barcode, slot});
+    hT7.insert({barcode, slot});
 
     // ensure all hash tables have the same size after insertion
     if (this->size() != hT1.size()) 
@@ -121,6 +409,16 @@ bool GlassesDisplay::removeGlasses(unsigned int barcode) {
   // if pair is found, then it is removed and the function returns true
   // else returns false
 
+  const unsigned int* slot = hT1.find(barcode);
+  if (!slot)
+  {
+      return false;   //if not found return false
+  }
+
+  // release the stored Glasses and free its slot for reuse
+  glasses_[*slot] = Glasses();
+  freeSlots_.push_back(*slot);
+
   // remove the pair of glasses given the barcode from all 7 hashtables, return true if successful, otherwise return false
   if (hT1.erase(barcode) && hT2.erase(barcode) && hT3.erase(barcode) && hT4.erase(barcode) && hT5.erase(barcode) && hT6.erase(barcode) && hT7.erase(barcode)) 
   {
@@ -133,10 +431,86 @@ bool GlassesDisplay::removeGlasses(unsigned int barcode) {
   } 
   else 
   {
-      return false;   //if not found return false
+      throw std::length_error("Hash tables disagree on barcode " + std::to_string(barcode));
   }
 }
 
+void GlassesDisplay::addGlassesBatch(const Glasses* batch, size_t count) {
+    // hT1 decides which pairs are new, as in addGlasses, so barcodes already
+    // on display, or repeated within the batch, are skipped
+    std::vector<std::pair<unsigned int, unsigned int>> added;
+    added.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        unsigned int slot = freeSlots_.empty() ? glasses_.size() : freeSlots_.back();
+        if (hT1.insert({batch[i].barcode_, slot}))
+        {
+            storeGlasses(Glasses(batch[i]));
+            added.push_back({batch[i].barcode_, slot});
+        }
+    }
+
+    insertIntoOtherTables(added);
+
+    // ensure all hash tables have the same size after the whole batch
+    if (this->size() != hT1.size())
+    {
+        throw std::length_error("Hash table sizes are not the same after insertion");
+    }
+}
+
+size_t GlassesDisplay::removeGlassesBatch(const unsigned int* barcodes, size_t count) {
+    // remove from hT1 first, keeping the barcodes that were on display
+    std::vector<unsigned int> removed;
+    removed.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const unsigned int* slot = hT1.find(barcodes[i]);
+        if (slot)
+        {
+            glasses_[*slot] = Glasses();
+            freeSlots_.push_back(*slot);
+            hT1.erase(barcodes[i]);
+            removed.push_back(barcodes[i]);
+        }
+    }
+
+    std::vector<unsigned char> digits(7 * removed.size());
+    hashfctAll(removed.data(), removed.size(), digits.data());
+    forEachOtherTable(removed.size(), [&](auto& table, size_t fct) {
+        const unsigned char* hashes = digits.data() + fct * removed.size();
+        for (size_t i = 0; i < removed.size(); ++i)
+            table.erase(removed[i], hashes[i]);
+    });
+
+    // ensure all hash tables have the same size after the whole batch
+    if (this->size() != hT1.size())
+    {
+        throw std::length_error("Hash table sizes are not the same after removal");
+    }
+    return removed.size();
+}
+
+void GlassesDisplay::insertIntoOtherTables(const std::vector<std::pair<unsigned int, unsigned int>>& entries) {
+    // every table's hash of every barcode, in one pass
+    std::vector<unsigned int> barcodes(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i)
+        barcodes[i] = entries[i].first;
+    std::vector<unsigned char> digits(7 * entries.size());
+    hashfctAll(barcodes.data(), barcodes.size(), digits.data());
+
+    forEachOtherTable(entries.size(), [&](auto& table, size_t fct) {
+        const unsigned char* hashes = digits.data() + fct * entries.size();
+        for (size_t i = 0; i < entries.size(); ++i)
+            table.insert({entries[i].first, entries[i].second}, hashes[i]);
+    });
+}
+
+const Glasses* GlassesDisplay::findGlasses(unsigned int barcode) const {
+    const unsigned int* slot = hT1.find(barcode);
+    return slot ? &glasses_[*slot] : nullptr;
+}
+
 unsigned int GlassesDisplay::bestHashing() {
   // TO BE COMPLETED
   // function that decides the best has function, i.e. the ones among
@@ -154,32 +528,17 @@ unsigned int GlassesDisplay::bestHashing() {
 
   // Find the most balanced hash function
 
-    //create an array of pointers to the 7 hashtables
-    CustomHashTable* hTs[7] = {&hT1, &hT2, &hT3, &hT4, &hT5, &hT6, &hT7};
-    unsigned int min_balance = -1;
+    //the balance of each of the 7 hashtables; each table keeps its smallest
+    //and largest bucket sizes up to date as glasses come and go, so no
+    //bucket needs to be visited here
+    size_t balances[7];
+    size_t* balance = balances;
+    forEachTable([&](auto& table) { *balance++ = table.max_bucket_size() - table.min_bucket_size(); });
+    size_t min_balance = -1;
     unsigned int best_hash = 0;
-    //for loop to loop over each hashtable
     for (unsigned int i = 0; i < 7; ++i) 
     {
-        unsigned int min_bucket_size = -1;
-        unsigned int max_bucket_size = 0;
-        //for loop to get the size of each bucket from current hashtable
-        for (unsigned int j = 0; j < 10; ++j) 
-        {
-            unsigned int current_bucket_size = hTs[i]->bucket_size(j);  //get bucket size of each bucket
-            //if bucket size is less than min bucket size, update value
-            if (current_bucket_size < min_bucket_size)
-            {
-              min_bucket_size = current_bucket_size;
-            }
-            //if bucket size is greater than max bucket size, update value
-            if (current_bucket_size > max_bucket_size)
-            {
-              max_bucket_size = current_bucket_size;
-            }
-        }
-        //calculate the balance for current hashtable
-        unsigned int current_balance = max_bucket_size - min_bucket_size;   
+        size_t current_balance = balances[i];
         //compare and update the best hash variable if necessary
         if (current_balance < min_balance) 
         {
@@ -1,6 +1,9 @@
 #pragma once
+#include <cstddef>
 #include <string>
-#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "FlatHashTable.hpp"
 using std::string;
 
 //******************************
@@ -44,10 +47,40 @@ unsigned int hashfct6(unsigned int);
 // the seventh digit of some unique 7-digit key
 unsigned int hashfct7(unsigned int);
 
+// all seven hash functions for count barcodes at once: digits[k * count + i]
+// is hashfct<k + 1>(barcodes[i]). Each barcode is divided by ten seven
+// times, once per digit, by multiplying by a reciprocal; the last division
+// keeps hashfct1 right for barcodes of more than 7 digits. Runs eight
+// barcodes at a time with AVX2 when the processor has it.
+void hashfctAll(const unsigned int* barcodes, size_t count, unsigned char* digits);
+
+// the same hash as hashfct<K>, the K-th digit of a 7-digit key, as a
+// stateless functor: a table given DigitHash<K> calls it directly, so the
+// compiler inlines it and turns the division into a multiply and a shift,
+// where a function pointer costs an indirect call per hash
+template <unsigned int K>
+struct DigitHash {
+  static_assert(K >= 1 && K <= 7, "DigitHash picks one of the seven digits");
+
+  static constexpr unsigned int divisor() {
+    unsigned int d = 1;
+    for (unsigned int i = K; i < 7; ++i)
+      d *= 10;
+    return d;
+  }
+
+  unsigned int operator()(unsigned int barcode) const {
+    return barcode / divisor() % 10;
+  }
+};
+
 //******************************
 // Typedef for custom hash table
 //******************************
-typedef std::unordered_map<unsigned int, Glasses, decltype(&hashfct1)> CustomHashTable;
+// maps a barcode to the slot in GlassesDisplay's store holding its Glasses,
+// hashed on its K-th digit
+template <unsigned int K>
+using CustomHashTable = FlatHashTable<unsigned int, unsigned int, DigitHash<K>>;
 
 
 // class to store the bow collection
@@ -60,6 +93,15 @@ public:
   // then it returns true; TO BE COMPLETED
   bool removeGlasses(unsigned int barcode);
 
+  // adds count pairs of glasses at once, as addGlasses would one by one, but
+  // updates the tables other than the first in parallel, one thread per
+  // table, and checks the table sizes only once at the end
+  void addGlassesBatch(const Glasses* batch, size_t count);
+
+  // removes count pairs of glasses at once, as removeGlasses would one by
+  // one, updating the tables in parallel; returns how many were on display
+  size_t removeGlassesBatch(const unsigned int* barcodes, size_t count);
+
   // identifies which hash function (among the seven provided, fct1 - fct7)
   // computes the most balanced hash table; TO BE COMPLETED
   unsigned int bestHashing();
@@ -68,20 +110,52 @@ public:
   // with the given filename; THIS FUNCTION IS COMPLETE
   void readTextfile(string filename);
 
+  // Load the same text file format as readTextfile, much faster: the file
+  // is memory-mapped and scanned by hand, the tables are reserved up front
+  // from its line count, and records are inserted a batch at a time.
+  // Loading stops at the first record whose barcode is not a number.
+  // Throws std::invalid_argument if the file cannot be opened.
+  void bulkLoadTextfile(string filename);
+
   // size of a hashtable. Throws exception if the sizes differ. Completed
   size_t size();
 
+  // the pair of glasses with the given barcode, or nullptr if there is none
+  const Glasses* findGlasses(unsigned int barcode) const;
+
   // constructor that initializes seven hashtables with different hash functions
   GlassesDisplay():
-    hT1{10,hashfct1},
-    hT2{10,hashfct2},
-    hT3{10,hashfct3},
-    hT4{10,hashfct4},
-    hT5{10,hashfct5},
-    hT6{10,hashfct6},
-    hT7{10,hashfct7}{ }
+    hT1{10,DigitHash<1>()},
+    hT2{10,DigitHash<2>()},
+    hT3{10,DigitHash<3>()},
+    hT4{10,DigitHash<4>()},
+    hT5{10,DigitHash<5>()},
+    hT6{10,DigitHash<6>()},
+    hT7{10,DigitHash<7>()}{ }
 
 private:
-  CustomHashTable hT1, hT2, hT3, hT4, hT5, hT6, hT7;
+  CustomHashTable<1> hT1;
+  CustomHashTable<2> hT2;
+  CustomHashTable<3> hT3;
+  CustomHashTable<4> hT4;
+  CustomHashTable<5> hT5;
+  CustomHashTable<6> hT6;
+  CustomHashTable<7> hT7;
   // add other private member variables as needed
+
+  // every pair of glasses is stored once, here; the hash tables only hold
+  // slot indices into it. Slots freed by removeGlasses are reused.
+  std::vector<Glasses> glasses_;
+  std::vector<unsigned int> freeSlots_;
+
+  unsigned int storeGlasses(Glasses&& glasses);
+
+  // batches smaller than this update hT2 to hT7 on the calling thread
+  static const size_t PARALLEL_BATCH = 4096;
+
+  void insertIntoOtherTables(const std::vector<std::pair<unsigned int, unsigned int>>& entries);
+  // the tables have different types, so these call a generic update once
+  // per table
+  template <typename Update> void forEachTable(Update update);
+  template <typename Update> void forEachOtherTable(size_t batchSize, Update update);
 };
@@ -0,0 +1,114 @@
+///////////////////////////////////////////////////////////////////////////////
+// hashing_bench.cpp
+//
+// Timing harness for the hash tables behind GlassesDisplay. Compares a
+// FlatHashTable hashed by a DigitHash<K> functor, as GlassesDisplay's tables
+// are now, with the same table hashed through a pointer to hashfct<K>, as
+// they were before, for every K from 1 to 7.
+//
+// FlatHashTable only calls its Hash on insert and erase, to keep the bucket
+// counts, so those are where the two differ; find is timed as well, as a
+// baseline that never hashes. Each operation is run over n random 7-digit
+// barcodes (10^6 by default), and the median of five runs is printed in
+// millions of operations per second.
+//
+// Usage: ./hashing_bench [n]
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "GlassesDisplay.hpp"
+
+using namespace std;
+
+const int RUNS = 5;
+
+// Operations per second for insert, find and erase, each the median of RUNS
+// runs over every barcode.
+struct throughput {
+  double insert, find, erase;
+};
+
+double median(vector<double> samples) {
+  sort(samples.begin(), samples.end());
+  return samples[samples.size() / 2];
+}
+
+template <typename Hash>
+throughput time_table(const vector<unsigned int>& barcodes, Hash hash) {
+  typedef chrono::steady_clock clock;
+  vector<double> inserts, finds, erases;
+  size_t found = 0;
+
+  for (int run = 0; run < RUNS; ++run) {
+    FlatHashTable<unsigned int, unsigned int, Hash> table(10, hash);
+    table.reserve(barcodes.size());
+
+    auto start = clock::now();
+    for (unsigned int barcode : barcodes) {
+      table.insert({barcode, barcode});
+    }
+    auto inserted = clock::now();
+    for (unsigned int barcode : barcodes) {
+      found += (table.find(barcode) != nullptr);
+    }
+    auto searched = clock::now();
+    for (unsigned int barcode : barcodes) {
+      table.erase(barcode);
+    }
+    auto erased = clock::now();
+
+    inserts.push_back(chrono::duration<double>(inserted - start).count());
+    finds.push_back(chrono::duration<double>(searched - inserted).count());
+    erases.push_back(chrono::duration<double>(erased - searched).count());
+  }
+  if (found != RUNS * barcodes.size()) {
+    cerr << "lookups missed " << RUNS * barcodes.size() - found << " barcodes" << endl;
+    exit(1);
+  }
+
+  double n = barcodes.size();
+  return throughput { n / median(inserts), n / median(finds), n / median(erases) };
+}
+
+template <unsigned int K>
+void compare(const vector<unsigned int>& barcodes, unsigned int (*pointer)(unsigned int)) {
+  throughput functor = time_table(barcodes, DigitHash<K>());
+  throughput indirect = time_table(barcodes, pointer);
+  cout << "digit " << K << fixed << setprecision(1)
+       << "  insert " << setw(6) << functor.insert / 1e6 << " vs " << setw(6) << indirect.insert / 1e6
+       << "  find " << setw(6) << functor.find / 1e6 << " vs " << setw(6) << indirect.find / 1e6
+       << "  erase " << setw(6) << functor.erase / 1e6 << " vs " << setw(6) << indirect.erase / 1e6
+       << endl;
+}
+
+int main(int argc, char* argv[]) {
+  size_t n = (argc > 1) ? strtoull(argv[1], nullptr, 10) : 1000000;
+
+  // distinct barcodes, so every insert adds and every erase removes
+  mt19937 rng(335);
+  vector<unsigned int> barcodes(9000000);
+  for (size_t i = 0; i < barcodes.size(); ++i) {
+    barcodes[i] = 1000000 + i;
+  }
+  shuffle(barcodes.begin(), barcodes.end(), rng);
+  barcodes.resize(min(n, barcodes.size()));
+
+  cout << "M ops/s over " << barcodes.size() << " barcodes, DigitHash<K> vs hashfct<K> pointer" << endl;
+  compare<1>(barcodes, hashfct1);
+  compare<2>(barcodes, hashfct2);
+  compare<3>(barcodes, hashfct3);
+  compare<4>(barcodes, hashfct4);
+  compare<5>(barcodes, hashfct5);
+  compare<6>(barcodes, hashfct6);
+  compare<7>(barcodes, hashfct7);
+  return 0;
+}
@@ -1,6 +1,13 @@
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
 #include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "rubrictest.hpp"
 #include "GlassesDisplay.hpp"
@@ -123,5 +130,190 @@ int main() {
 		   [&]() {
 TEST_EQUAL( "bestHashing() after removing 8890123", 4, changed_pairs2.bestHashing() );
 		   });
+  rubric.criterion("flat hash table matches std::unordered_map", 1,
+		   [&]() {
+     FlatHashTable<unsigned int, Glasses, decltype(&hashfct1)> table{10, hashfct7};
+     std::unordered_map<unsigned int, Glasses> reference;
+     std::mt19937 rng(335);
+     for (unsigned int i = 0; i < 20000; ++i) {
+       unsigned int barcode = 1000000 + rng() % 5000;
+       if (rng() % 3) {
+         bool inserted = table.insert({barcode, Glasses("red", "oval", "Dior", barcode)});
+         TEST_EQUAL("insert", reference.insert({barcode, Glasses("red", "oval", "Dior", barcode)}).second, inserted);
+       } else {
+         TEST_EQUAL("erase", reference.erase(barcode), table.erase(barcode));
+       }
+     }
+     TEST_EQUAL("size", reference.size(), table.size());
+     for (unsigned int barcode = 1000000; barcode < 1005000; ++barcode) {
+       const Glasses* found = table.find(barcode);
+       TEST_EQUAL("find", reference.count(barcode), found ? 1 : 0);
+       if (found) {
+         TEST_EQUAL("found barcode", barcode, found->barcode_);
+       }
+     }
+     size_t buckets[10] = {0};
+     for (auto& entry : reference) {
+       buckets[hashfct7(entry.first)]++;
+     }
+     for (unsigned int j = 0; j < 10; ++j) {
+       TEST_EQUAL("bucket_size", buckets[j], table.bucket_size(j));
+     }
+		   });
+
+  rubric.criterion("glasses are stored once and found by barcode", 1,
+		   [&]() {
+     GlassesDisplay display;
+     display.addGlasses("red", "oval", "Dior", 1234567U);
+     display.addGlasses("pink", "round", "Gucci", 2345678U);
+     display.addGlasses("blue", "square", "Prada", 1234567U);
+     TEST_EQUAL("duplicate barcode ignored", 2, display.size());
+     TEST_EQUAL("found color", "red", display.findGlasses(1234567U)->glassesColor_);
+     TEST_EQUAL("found brand", "Gucci", display.findGlasses(2345678U)->glassesBrand_);
+     TEST_TRUE("missing barcode", display.findGlasses(7654321U) == nullptr);
+
+     TEST_TRUE("remove", display.removeGlasses(1234567U));
+     TEST_FALSE("remove twice", display.removeGlasses(1234567U));
+     TEST_TRUE("removed barcode", display.findGlasses(1234567U) == nullptr);
+     display.addGlasses("green", "cat-eye", "Oakley", 3456789U);
+     TEST_EQUAL("freed slot reused", "green", display.findGlasses(3456789U)->glassesColor_);
+     TEST_EQUAL("other glasses kept", "pink", display.findGlasses(2345678U)->glassesColor_);
+
+     GlassesDisplay copy(display);
+     copy.removeGlasses(2345678U);
+     TEST_EQUAL("copy is independent", "pink", display.findGlasses(2345678U)->glassesColor_);
+     TEST_EQUAL("size after copy removal", 1, copy.size());
+		   });
+
+  rubric.criterion("bulkLoadTextfile() matches readTextfile()", 1,
+		   [&]() {
+     for (const char* filename : {"in1.txt", "in2.txt"}) {
+       GlassesDisplay streamed, bulk;
+       streamed.readTextfile(filename);
+       bulk.bulkLoadTextfile(filename);
+       TEST_EQUAL("size", streamed.size(), bulk.size());
+       TEST_EQUAL("bestHashing()", streamed.bestHashing(), bulk.bestHashing());
+       for (unsigned int barcode : {1234567U, 2345678U, 8890123U, 5678901U}) {
+         const Glasses* expected = streamed.findGlasses(barcode);
+         const Glasses* loaded = bulk.findGlasses(barcode);
+         TEST_EQUAL("found", expected != nullptr, loaded != nullptr);
+         if (expected && loaded) {
+           TEST_EQUAL("color", expected->glassesColor_, loaded->glassesColor_);
+           TEST_EQUAL("shape", expected->glassesShape_, loaded->glassesShape_);
+           TEST_EQUAL("brand", expected->glassesBrand_, loaded->glassesBrand_);
+         }
+       }
+     }
+     GlassesDisplay bulk;
+     bool threw = false;
+     try { bulk.bulkLoadTextfile("no-such-file.txt"); } catch (const std::invalid_argument&) { threw = true; }
+     TEST_TRUE("missing file", threw);
+
+     std::ofstream("empty.txt").close();
+     GlassesDisplay empty;
+     empty.bulkLoadTextfile("empty.txt");
+     std::remove("empty.txt");
+     TEST_EQUAL("empty file", 0, empty.size());
+		   });
+
+  rubric.criterion("addGlassesBatch() and removeGlassesBatch() match one at a time", 1,
+		   [&]() {
+     // big enough to update the tables on worker threads
+     std::mt19937 rng(335);
+     std::vector<Glasses> batch;
+     for (unsigned int i = 0; i < 20000; ++i)
+       batch.emplace_back("color" + std::to_string(i), "shape", "brand", 1000000 + rng() % 9000000);
+     std::vector<unsigned int> barcodes;
+     for (unsigned int i = 0; i < 12000; ++i)
+       barcodes.push_back(1000000 + rng() % 9000000);
+
+     GlassesDisplay single, batched;
+     single.addGlasses("red", "round", "acme", batch[7].barcode_);
+     batched.addGlasses("red", "round", "acme", batch[7].barcode_);
+     for (const Glasses& g : batch)
+       single.addGlasses(g.glassesColor_, g.glassesShape_, g.glassesBrand_, g.barcode_);
+     batched.addGlassesBatch(batch.data(), batch.size());
+     TEST_EQUAL("size after add", single.size(), batched.size());
+     TEST_EQUAL("bestHashing() after add", single.bestHashing(), batched.bestHashing());
+
+     size_t removed = 0;
+     for (unsigned int barcode : barcodes)
+       removed += single.removeGlasses(barcode);
+     TEST_EQUAL("removed", removed, batched.removeGlassesBatch(barcodes.data(), barcodes.size()));
+     TEST_EQUAL("size after remove", single.size(), batched.size());
+     TEST_EQUAL("bestHashing() after remove", single.bestHashing(), batched.bestHashing());
+     for (const Glasses& g : batch) {
+       const Glasses* expected = single.findGlasses(g.barcode_);
+       const Glasses* found = batched.findGlasses(g.barcode_);
+       TEST_EQUAL("found", expected != nullptr, found != nullptr);
+       if (expected && found)
+         TEST_EQUAL("color", expected->glassesColor_, found->glassesColor_);
+     }
+
+     GlassesDisplay small;
+     small.addGlassesBatch(batch.data(), 3);
+     TEST_EQUAL("small batch", 3, small.size());
+     TEST_EQUAL("small remove", 1, small.removeGlassesBatch(&batch[1].barcode_, 1));
+     small.addGlassesBatch(batch.data(), 0);
+     TEST_EQUAL("empty add", 2, small.size());
+     TEST_EQUAL("empty remove", 0, small.removeGlassesBatch(barcodes.data(), 0));
+     TEST_EQUAL("remove none found", 0, small.removeGlassesBatch(&batch[1].barcode_, 1));
+		   });
+
+  rubric.criterion("min/max bucket sizes stay correct through inserts and erases", 1,
+		   [&]() {
+     std::mt19937 rng(23);
+     FlatHashTable<unsigned int, unsigned int, decltype(&hashfct1)> table(10, hashfct7);
+     for (unsigned int step = 0; step < 20000; ++step) {
+       unsigned int barcode = 1000000 + rng() % 500;
+       if (rng() % 3)
+         table.insert({barcode, step});
+       else
+         table.erase(barcode);
+       if (step % 97 == 0) {
+         size_t lo = table.bucket_size(0), hi = table.bucket_size(0);
+         for (size_t j = 1; j < table.bucket_count(); ++j) {
+           lo = std::min(lo, table.bucket_size(j));
+           hi = std::max(hi, table.bucket_size(j));
+         }
+         TEST_EQUAL("min_bucket_size()", lo, table.min_bucket_size());
+         TEST_EQUAL("max_bucket_size()", hi, table.max_bucket_size());
+       }
+     }
+		   });
+
+  rubric.criterion("hashfctAll() matches the seven hash functions", 1,
+		   [&]() {
+     std::mt19937 rng(24);
+     std::vector<unsigned int> barcodes = {0U, 9U, 1234567U, 6789012U, 9999999U, 4294967295U};
+     for (unsigned int i = 0; i < 1000; ++i)
+       barcodes.push_back(rng() % 3 ? 1000000 + rng() % 9000000 : rng());
+     unsigned int (*fcts[7])(unsigned int) = {hashfct1, hashfct2, hashfct3, hashfct4, hashfct5, hashfct6, hashfct7};
+     // odd counts leave a tail after the last full vector
+     for (size_t count : {barcodes.size(), size_t(13), size_t(5)}) {
+       std::vector<unsigned char> digits(7 * count);
+       hashfctAll(barcodes.data(), count, digits.data());
+       for (size_t k = 0; k < 7; ++k)
+         for (size_t i = 0; i < count; ++i)
+           TEST_EQUAL("hashfct" + std::to_string(k + 1) + "(" + std::to_string(barcodes[i]) + ")",
+                      fcts[k](barcodes[i]), digits[k * count + i]);
+     }
+		   });
+
+  rubric.criterion("DigitHash<K> matches hashfct<K>", 1,
+		   [&]() {
+     std::mt19937 rng(25);
+     for (unsigned int i = 0; i < 1000; ++i) {
+       unsigned int barcode = i < 500 ? 1000000 + rng() % 9000000 : rng();
+       TEST_EQUAL("DigitHash<1>", hashfct1(barcode), DigitHash<1>()(barcode));
+       TEST_EQUAL("DigitHash<2>", hashfct2(barcode), DigitHash<2>()(barcode));
+       TEST_EQUAL("DigitHash<3>", hashfct3(barcode), DigitHash<3>()(barcode));
+       TEST_EQUAL("DigitHash<4>", hashfct4(barcode), DigitHash<4>()(barcode));
+       TEST_EQUAL("DigitHash<5>", hashfct5(barcode), DigitHash<5>()(barcode));
+       TEST_EQUAL("DigitHash<6>", hashfct6(barcode), DigitHash<6>()(barcode));
+       TEST_EQUAL("DigitHash<7>", hashfct7(barcode), DigitHash<7>()(barcode));
+     }
+		   });
+
   return rubric.run();
 }